@@ -1,3 +1,20 @@
+; NOTE(khvorov) One source for both ABIs. Kernels take (ptr, size[, mask]) in ARG0..ARG2 and only use
+; scratch registers that are volatile under both conventions (rax, r9, r10, r11, xmm/ymm/zmm0).
+; The few that take a fourth argument in ARG3 can't use r9 as scratch since that's ARG3 on Windows.
+; Kernels that touch ymm/zmm end with vzeroupper so the C code after them doesn't pay for AVX-SSE transitions
+%ifidn __OUTPUT_FORMAT__, win64
+    %define ARG0 rcx
+    %define ARG1 rdx
+    %define ARG2 r8
+    %define ARG3 r9
+%else
+    %define ARG0 rdi
+    %define ARG1 rsi
+    %define ARG2 rdx
+    %define ARG3 rcx
+    section .note.GNU-stack noalloc noexec nowrite progbits
+%endif
+
 global MOVAllBytesAsm
 global NOP3x1AllBytesAsm
 global NOP1x3AllBytesAsm
@@ -22,15 +39,27 @@ global LoadManyTimesX2_128
 global LoadManyTimesX2_256
 global LoadManyTimesX2_512
 global BandwidthTest
+global BandwidthTestBlocks
+global PointerChase
+global StoreLoadAlias
+global PrefetchGatherNone
+global PrefetchGatherT0
+global PrefetchGatherT1
+global PrefetchGatherT2
+global PrefetchGatherNTA
+global StoreBandwidthBlocks
+global StoreBandwidthBlocksNT128
+global StoreBandwidthBlocksNT
+global StoreBandwidthRepStosb
 
 section .text
 
 MOVAllBytesAsm:
     xor rax, rax
 .loop:
-    mov byte [rcx + rax], al
+    mov byte [ARG0 + rax], al
     inc rax
-    cmp rax, rdx
+    cmp rax, ARG1
 jne .loop
     ret
 
@@ -38,9 +67,9 @@ MOVAllBytesAsmAlign64:
     xor rax, rax
 align 64
 .loop:
-    mov byte [rcx + rax], al
+    mov byte [ARG0 + rax], al
     inc rax
-    cmp rax, rdx
+    cmp rax, ARG1
 jne .loop
     ret
 
@@ -51,9 +80,9 @@ align 64
 nop
 %endrep
 .loop:
-    mov byte [rcx + rax], al
+    mov byte [ARG0 + rax], al
     inc rax
-    cmp rax, rdx
+    cmp rax, ARG1
 jne .loop
     ret
 
@@ -62,7 +91,7 @@ NOP3x1AllBytesAsm:
 .loop:
     db 0x0f, 0x1f, 0x00
     inc rax
-    cmp rax, rdx
+    cmp rax, ARG1
 jne .loop
     ret
 
@@ -73,7 +102,7 @@ NOP1x3AllBytesAsm:
     nop
     nop
     inc rax
-    cmp rax, rdx
+    cmp rax, ARG1
 jne .loop
     ret
 
@@ -90,7 +119,7 @@ NOP1x9AllBytesAsm:
     nop
     nop
     inc rax
-    cmp rax, rdx
+    cmp rax, ARG1
 jne .loop
     ret
 
@@ -98,176 +127,178 @@ CMPAllBytesAsm:
     xor rax, rax
 .loop:
     inc rax
-    cmp rax, rdx
+    cmp rax, ARG1
 jne .loop
     ret
 
 DECAllBytesAsm:
 .loop:
-    dec rdx
+    dec ARG1
 jnz .loop
     ret
 
 ConditionalNopAsm:
     xor rax, rax
 .loop:
-    mov r10, [rcx + rax]
+    mov r10, [ARG0 + rax]
     inc rax
     test r10, 1
     jnz .skip
     nop
 .skip:
-    cmp rax, rdx
+    cmp rax, ARG1
     jne .loop
     ret
 
 StoreManyTimesX1:
     xor rax, rax
 .loop:
-    mov [rcx], rax
+    mov [ARG0], rax
     inc rax
-    cmp rax, rdx
+    cmp rax, ARG1
 jne .loop
     ret
 
 StoreManyTimesX2:
     xor rax, rax
 .loop:
-    mov [rcx], rax
-    mov [rcx], rax
+    mov [ARG0], rax
+    mov [ARG0], rax
     inc rax
-    cmp rax, rdx
+    cmp rax, ARG1
 jne .loop
     ret
 
 StoreManyTimesX3:
     xor rax, rax
 .loop:
-    mov [rcx], rax
-    mov [rcx], rax
-    mov [rcx], rax
+    mov [ARG0], rax
+    mov [ARG0], rax
+    mov [ARG0], rax
     inc rax
-    cmp rax, rdx
+    cmp rax, ARG1
 jne .loop
     ret
 
 StoreManyTimesX4:
     xor rax, rax
 .loop:
-    mov [rcx], rax
-    mov [rcx], rax
-    mov [rcx], rax
-    mov [rcx], rax
+    mov [ARG0], rax
+    mov [ARG0], rax
+    mov [ARG0], rax
+    mov [ARG0], rax
     inc rax
-    cmp rax, rdx
+    cmp rax, ARG1
 jne .loop
     ret
 
 LoadManyTimesX1:
     xor rax, rax
 .loop:
-    mov r8, [rcx]
+    mov r11, [ARG0]
     inc rax
-    cmp rax, rdx
+    cmp rax, ARG1
 jne .loop
     ret
 
 LoadManyTimesX2:
     xor rax, rax
 .loop:
-    mov r8, [rcx]
-    mov r8, [rcx]
+    mov r11, [ARG0]
+    mov r11, [ARG0]
     inc rax
-    cmp rax, rdx
+    cmp rax, ARG1
 jne .loop
     ret
 
 LoadManyTimesX3:
     xor rax, rax
 .loop:
-    mov r8, [rcx]
-    mov r8, [rcx]
-    mov r8, [rcx]
+    mov r11, [ARG0]
+    mov r11, [ARG0]
+    mov r11, [ARG0]
     inc rax
-    cmp rax, rdx
+    cmp rax, ARG1
 jne .loop
     ret
 
 LoadManyTimesX4:
     xor rax, rax
 .loop:
-    mov r8, [rcx]
-    mov r8, [rcx]
-    mov r8, [rcx]
-    mov r8, [rcx]
+    mov r11, [ARG0]
+    mov r11, [ARG0]
+    mov r11, [ARG0]
+    mov r11, [ARG0]
     inc rax
-    cmp rax, rdx
+    cmp rax, ARG1
 jne .loop
     ret
 
 StoreManyTimesX2_64:
     xor rax, rax
 .loop:
-    mov [rcx], r8
-    mov [rcx + 8], r8
+    mov [ARG0], rax
+    mov [ARG0 + 8], rax
     add rax, 8
-    cmp rax, rdx
+    cmp rax, ARG1
 jne .loop
     ret
 
 StoreManyTimesX2_128:
     xor rax, rax
 .loop:
-    movdqu [rcx], xmm0
-    movdqu [rcx + 16], xmm0
+    movdqu [ARG0], xmm0
+    movdqu [ARG0 + 16], xmm0
     add rax, 16
-    cmp rax, rdx
+    cmp rax, ARG1
 jne .loop
     ret
 
 LoadManyTimesX2_64:
     xor rax, rax
 .loop:
-    mov r8, [rcx]
-    mov r8, [rcx + 8]
+    mov r11, [ARG0]
+    mov r11, [ARG0 + 8]
     add rax, 8
-    cmp rax, rdx
+    cmp rax, ARG1
 jne .loop
     ret
 
 LoadManyTimesX2_128:
     xor rax, rax
 .loop:
-    movdqu xmm0, [rcx]
-    movdqu xmm0, [rcx + 16]
+    movdqu xmm0, [ARG0]
+    movdqu xmm0, [ARG0 + 16]
     add rax, 16
-    cmp rax, rdx
+    cmp rax, ARG1
 jl .loop
     ret
 
 LoadManyTimesX2_256:
     xor rax, rax
 .loop:
-    vmovdqu ymm0, [rcx]
-    vmovdqu ymm0, [rcx + 32]
+    vmovdqu ymm0, [ARG0]
+    vmovdqu ymm0, [ARG0 + 32]
     add rax, 32
-    cmp rax, rdx
+    cmp rax, ARG1
 jl .loop
+    vzeroupper
     ret
 
 LoadManyTimesX2_512:
     xor rax, rax
 .loop:
-    vmovdqu64 zmm0, [rcx]
-    vmovdqu64 zmm0, [rcx + 64]
+    vmovdqu64 zmm0, [ARG0]
+    vmovdqu64 zmm0, [ARG0 + 64]
     add rax, 64
-    cmp rax, rdx
+    cmp rax, ARG1
 jl .loop
+    vzeroupper
     ret
 
 BandwidthTest:
     xor rax, rax
-    mov r9, rcx
+    mov r9, ARG0
 .loop:
     vmovdqu ymm0, [r9]
     vmovdqu ymm0, [r9 + 32]
@@ -275,8 +306,155 @@ BandwidthTest:
     vmovdqu ymm0, [r9 + 32 + 32 + 32]
     add rax, 128
     mov r9, rax
-    and r9, r8
-    add r9, rcx
-    cmp rax, rdx
+    and r9, ARG2
+    add r9, ARG0
+    cmp rax, ARG1
 jl .loop
+    vzeroupper
+    ret
+
+; NOTE(khvorov) (ptr, outerCount, blockSize) reads the first blockSize bytes outerCount times,
+; blockSize has to be a non-zero multiple of 128 but doesn't have to be a power of two
+BandwidthTestBlocks:
+.outer:
+    mov r9, ARG0
+    mov rax, ARG2
+.inner:
+    vmovdqu ymm0, [r9]
+    vmovdqu ymm0, [r9 + 32]
+    vmovdqu ymm0, [r9 + 32 + 32]
+    vmovdqu ymm0, [r9 + 32 + 32 + 32]
+    add r9, 128
+    sub rax, 128
+jnz .inner
+    dec ARG1
+jnz .outer
+    vzeroupper
+    ret
+
+; NOTE(khvorov) (start, count) follows count pointers from start, every load depends on the previous one
+PointerChase:
+    mov rax, ARG0
+.loop:
+    mov rax, [rax]
+    dec ARG1
+jnz .loop
+    ret
+
+; NOTE(khvorov) (ptr, count, offset) stores to ptr and loads from ptr + offset count times. The load doesn't depend on
+; the store unless offset is 0, so it should run at a load per cycle unless the core thinks the addresses overlap
+StoreLoadAlias:
+    xor eax, eax
+.loop:
+    mov [ARG0], rax
+    mov rax, [ARG0 + ARG2]
+    dec ARG1
+jnz .loop
+    ret
+
+; NOTE(khvorov) (base, offsets, count, distance) loads a qword at base + offsets[i] for every i < count and prefetches
+; base + offsets[i + distance] with the given hint, so offsets has count + distance entries. The loads don't depend
+; on each other. None still reads the offset ahead and only skips the prefetch, it's the hardware prefetcher alone
+%macro PrefetchGather 2
+%1:
+    xor rax, rax
+    lea r10, [ARG1 + ARG3 * 8]
+.loop:
+    mov r11, [r10 + rax * 8]
+%ifnidn %2, none
+    %2 [ARG0 + r11]
+%endif
+    mov r11, [ARG1 + rax * 8]
+    mov r11, [ARG0 + r11]
+    inc rax
+    cmp rax, ARG2
+jne .loop
+    ret
+%endmacro
+
+PrefetchGather PrefetchGatherNone, none
+PrefetchGather PrefetchGatherT0, prefetcht0
+PrefetchGather PrefetchGatherT1, prefetcht1
+PrefetchGather PrefetchGatherT2, prefetcht2
+PrefetchGather PrefetchGatherNTA, prefetchnta
+
+; NOTE(khvorov) Store versions of BandwidthTestBlocks, same (ptr, outerCount, blockSize) and the same 128 byte unroll.
+; The non-temporal ones need ptr aligned to the vector size and fence once at the end
+StoreBandwidthBlocks:
+    vpxor ymm0, ymm0, ymm0
+.outer:
+    mov r9, ARG0
+    mov rax, ARG2
+.inner:
+    vmovdqu [r9], ymm0
+    vmovdqu [r9 + 32], ymm0
+    vmovdqu [r9 + 32 + 32], ymm0
+    vmovdqu [r9 + 32 + 32 + 32], ymm0
+    add r9, 128
+    sub rax, 128
+jnz .inner
+    dec ARG1
+jnz .outer
+    vzeroupper
+    ret
+
+StoreBandwidthBlocksNT128:
+    pxor xmm0, xmm0
+.outer:
+    mov r9, ARG0
+    mov rax, ARG2
+.inner:
+    movntdq [r9], xmm0
+    movntdq [r9 + 16], xmm0
+    movntdq [r9 + 32], xmm0
+    movntdq [r9 + 48], xmm0
+    movntdq [r9 + 64], xmm0
+    movntdq [r9 + 80], xmm0
+    movntdq [r9 + 96], xmm0
+    movntdq [r9 + 112], xmm0
+    add r9, 128
+    sub rax, 128
+jnz .inner
+    dec ARG1
+jnz .outer
+    sfence
+    ret
+
+StoreBandwidthBlocksNT:
+    vpxor ymm0, ymm0, ymm0
+.outer:
+    mov r9, ARG0
+    mov rax, ARG2
+.inner:
+    vmovntdq [r9], ymm0
+    vmovntdq [r9 + 32], ymm0
+    vmovntdq [r9 + 32 + 32], ymm0
+    vmovntdq [r9 + 32 + 32 + 32], ymm0
+    add r9, 128
+    sub rax, 128
+jnz .inner
+    dec ARG1
+jnz .outer
+    sfence
+    vzeroupper
+    ret
+
+; NOTE(khvorov) rep stosb wants rdi/rcx/al, rdi is callee saved on win64
+StoreBandwidthRepStosb:
+%ifidn __OUTPUT_FORMAT__, win64
+    push rdi
+%endif
+    mov r9, ARG0
+    mov r10, ARG1
+    mov r11, ARG2
+    xor eax, eax
+.outer:
+    mov rdi, r9
+    mov rcx, r11
+    rep stosb
+    dec r10
+jnz .outer
+%ifidn __OUTPUT_FORMAT__, win64
+    pop rdi
+%endif
     ret
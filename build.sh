@@ -1,3 +1,10 @@
 SCRIPT_DIR=$(dirname "$0")
-RUN_BIN=$SCRIPT_DIR/hm2.exe
-clang -g -Wall -Wextra $SCRIPT_DIR/hm2.c -o $RUN_BIN -lpthread -lm && $RUN_BIN
+TARGET=${1:-hm2}
+if [ "$TARGET" = "pawp" ]; then
+    RUN_BIN=$SCRIPT_DIR/pawp.exe
+    nasm -f elf64 -g $SCRIPT_DIR/asm.asm -o $SCRIPT_DIR/asm.o && \
+    clang -DPAWP_PROFILE -g -O1 -Wall -Wextra $SCRIPT_DIR/pawp.c $SCRIPT_DIR/asm.o -o $RUN_BIN -lpthread -lm && $RUN_BIN
+else
+    RUN_BIN=$SCRIPT_DIR/hm2.exe
+    clang -g -Wall -Wextra $SCRIPT_DIR/hm2.c -o $RUN_BIN -lpthread -lm && $RUN_BIN
+fi
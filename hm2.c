@@ -1,7 +1,16 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include "cbuild.h"
 #include "math.h"
 
+#if prb_PLATFORM_WINDOWS
 #include <psapi.h>
+#elif prb_PLATFORM_LINUX
+#include <sys/resource.h>
+#include <x86intrin.h>
+#endif
 
 
 #define function static
@@ -59,6 +68,7 @@ typedef struct Profile {
 
 static Profile globalProfile;
 
+#ifdef PAWP_PROFILE
 function TimedSection
 profileThroughputBegin_(Str name, isize index, isize dataSize) {
     assert(index < PROFILE_ANCHOR_COUNT);
@@ -89,6 +99,7 @@ profileThroughputEnd_(TimedSection section) {
 
     globalProfile.currentOpenIndex = section.parentIndex;
 }
+#endif
 
 function void
 addTime(prb_GrowingStr* gstr, u64 total, u64 freqPerSec, u64 diff) {
@@ -345,32 +356,48 @@ typedef struct RepetitionTester {
 
     u64 minDiffPF;
     u64 maxDiffPF;
+    u64 majorPFSum;
+    u64 contextSwitchSum;
+    u64 involuntaryContextSwitchSum;
 
     u64 diffCount;
 
     u64 lastBegin;
+#if prb_PLATFORM_WINDOWS
     PROCESS_MEMORY_COUNTERS lastCounters;
+#elif prb_PLATFORM_LINUX
+    struct rusage lastUsage;
+#endif
 
     u64 waited;
 
+#if prb_PLATFORM_WINDOWS
     HANDLE process;
+#endif
 } RepetitionTester;
 
 function RepetitionTester
 createRepetitionTester(u64 freqPerSec, u64 expectedSize) {
     RepetitionTester tester = {
         .freqPerSec = freqPerSec, .toWait = freqPerSec, .expectedSize = expectedSize, .minDiffTime = UINT64_MAX, .minDiffPF = UINT64_MAX,
-        .process = OpenProcess(PROCESS_QUERY_INFORMATION  | PROCESS_VM_READ, FALSE, GetCurrentProcessId())
     };
+#if prb_PLATFORM_WINDOWS
+    tester.process = OpenProcess(PROCESS_QUERY_INFORMATION  | PROCESS_VM_READ, FALSE, GetCurrentProcessId());
     prb_assert(tester.process);
+#endif
     return tester;
 }
 
 function void
 repeatBeginTime(RepetitionTester* tester) {
-    tester->lastBegin = __rdtsc();
+#if prb_PLATFORM_WINDOWS
     BOOL GetProcessMemoryInfoResult = GetProcessMemoryInfo(tester->process, &tester->lastCounters, sizeof(tester->lastCounters));
     assert(GetProcessMemoryInfoResult);
+#elif prb_PLATFORM_LINUX
+    int getrusageResult = getrusage(RUSAGE_THREAD, &tester->lastUsage);
+    assert(getrusageResult == 0);
+#endif
+    tester->lastBegin = __rdtsc();
 }
 
 function void
@@ -390,11 +417,25 @@ repeatEndTime(RepetitionTester* tester) {
     tester->diffTimeSum += diffTime;
     tester->diffCount += 1;
 
+#if prb_PLATFORM_WINDOWS
     PROCESS_MEMORY_COUNTERS counters = {};
     BOOL GetProcessMemoryInfoResult = GetProcessMemoryInfo(tester->process, &counters, sizeof(counters));
     assert(GetProcessMemoryInfoResult);
 
     u64 diffPF = counters.PageFaultCount - tester->lastCounters.PageFaultCount;
+#elif prb_PLATFORM_LINUX
+    struct rusage usage = {};
+    int getrusageResult = getrusage(RUSAGE_THREAD, &usage);
+    assert(getrusageResult == 0);
+
+    struct rusage* last = &tester->lastUsage;
+    u64 diffMajorPF = usage.ru_majflt - last->ru_majflt;
+    u64 diffPF = usage.ru_minflt - last->ru_minflt + diffMajorPF;
+    u64 diffInvoluntary = usage.ru_nivcsw - last->ru_nivcsw;
+    tester->majorPFSum += diffMajorPF;
+    tester->involuntaryContextSwitchSum += diffInvoluntary;
+    tester->contextSwitchSum += usage.ru_nvcsw - last->ru_nvcsw + diffInvoluntary;
+#endif
     tester->minDiffPF = prb_min(tester->minDiffPF, diffPF);
     tester->maxDiffPF = prb_max(tester->maxDiffPF, diffPF);
 }
@@ -434,11 +475,285 @@ repeatPrint(Arena* arena, RepetitionTester* tester) {
     f64 maxKBPerPF = sizeKB / (f64)tester->maxDiffPF;
 
     prb_writeToStdout(prb_fmt(arena,
-        "repeat: min: %.2gs %.2ggb/s %lluPF %.2gKB/PF, max: %.2gs %.2ggb/s %lluPF %.2gKB/PF\n",
-        minSec, minBand, tester->minDiffPF, minKBPerPF, maxSec, maxBand, tester->maxDiffPF, maxKBPerPF
+        "repeat: min: %.2gs %.2ggb/s %lluPF %.2gKB/PF, max: %.2gs %.2ggb/s %lluPF %.2gKB/PF",
+        minSec, minBand, (unsigned long long)tester->minDiffPF, minKBPerPF, maxSec, maxBand, (unsigned long long)tester->maxDiffPF, maxKBPerPF
+    ));
+#if prb_PLATFORM_LINUX
+    f64 runs = (f64)tester->diffCount;
+    prb_writeToStdout(prb_fmt(arena,
+        ", majorPF/run: %.2g ctxsw/run: %.2g (involuntary %.2g)",
+        (f64)tester->majorPFSum / runs, (f64)tester->contextSwitchSum / runs, (f64)tester->involuntaryContextSwitchSum / runs
     ));
+#endif
+    prb_writeToStdout(STR("\n"));
+}
+
+#if prb_PLATFORM_LINUX
+// NOTE(khvorov) Ways for the input stage to get the file in. Chunked ones reuse one buffer of the swept chunk size,
+// mmap ones load a byte per cache line since mapping alone doesn't read anything and a read copies every line.
+// O_DIRECT skips the page cache so it reads from the device even when the cache is warm
+typedef enum ReadStrategy {
+    ReadStrategy_ReadAll,
+    ReadStrategy_Chunked,
+    ReadStrategy_ChunkedFadvise,
+    ReadStrategy_ChunkedReadahead,
+    ReadStrategy_ChunkedDirect,
+    ReadStrategy_Mmap,
+    ReadStrategy_MmapPopulate,
+    ReadStrategy_Count,
+} ReadStrategy;
+
+static const char* globalReadStrategyNames[ReadStrategy_Count] = {
+    [ReadStrategy_ReadAll] = "read all",
+    [ReadStrategy_Chunked] = "read chunked",
+    [ReadStrategy_ChunkedFadvise] = "fadvise+chunked",
+    [ReadStrategy_ChunkedReadahead] = "readahead+chunked",
+    [ReadStrategy_ChunkedDirect] = "O_DIRECT chunked",
+    [ReadStrategy_Mmap] = "mmap",
+    [ReadStrategy_MmapPopulate] = "mmap populate",
+};
+
+function bool
+readStrategyIsChunked(ReadStrategy strategy) {
+    bool result = strategy >= ReadStrategy_Chunked && strategy <= ReadStrategy_ChunkedDirect;
+    return result;
 }
 
+// NOTE(khvorov) buf has to hold the whole file for ReadAll, chunkSize bytes otherwise. Aligned to the page for O_DIRECT
+function void
+readWithStrategy(const char* path, u64 fileSize, ReadStrategy strategy, uint8_t* buf, u64 chunkSize) {
+    int fd = open(path, O_RDONLY | (strategy == ReadStrategy_ChunkedDirect ? O_DIRECT : 0));
+    assert(fd != -1);
+
+    u64 bytesRead = 0;
+    switch (strategy) {
+        case ReadStrategy_ReadAll: chunkSize = fileSize; break;
+        case ReadStrategy_ChunkedFadvise: {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        } break;
+        case ReadStrategy_ChunkedReadahead: readahead(fd, 0, fileSize); break;
+        default: break;
+    }
+
+    if (strategy == ReadStrategy_Mmap || strategy == ReadStrategy_MmapPopulate) {
+        int               mapFlags = MAP_PRIVATE | (strategy == ReadStrategy_MmapPopulate ? MAP_POPULATE : 0);
+        volatile uint8_t* mem = mmap(0, fileSize, PROT_READ, mapFlags, fd, 0);
+        assert(mem != MAP_FAILED);
+        for (u64 offset = 0; offset < fileSize; offset += 64) {
+            (void)mem[offset];
+        }
+        bytesRead = fileSize;
+        int munmapResult = munmap((void*)mem, fileSize);
+        assert(munmapResult == 0);
+    } else {
+        for (;;) {
+            ssize_t readResult = read(fd, buf, chunkSize);
+            assert(readResult >= 0);
+            if (readResult == 0) {
+                break;
+            }
+            bytesRead += readResult;
+        }
+    }
+
+    assert(bytesRead == fileSize);
+    close(fd);
+}
+
+// NOTE(khvorov) Evicts the file from the page cache without root, returns how many of its pages are still resident.
+// Dirty pages don't get dropped so it syncs first, tmpfs and the like keep everything
+function u64
+dropFromPageCache(Arena* arena, const char* path, u64 fileSize) {
+    int fd = open(path, O_RDONLY);
+    assert(fd != -1);
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+    prb_TempMemory temp = prb_beginTempMemory(arena);
+    u64            pageCount = (fileSize + 4 * prb_KILOBYTE - 1) / (4 * prb_KILOBYTE);
+    uint8_t*       residency = prb_arenaAllocAndZero(arena, pageCount, 1);
+    void*          mem = mmap(0, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    assert(mem != MAP_FAILED);
+    int mincoreResult = mincore(mem, fileSize, residency);
+    assert(mincoreResult == 0);
+    u64 result = 0;
+    for (u64 pageIndex = 0; pageIndex < pageCount; pageIndex++) {
+        result += residency[pageIndex] & 1;
+    }
+    munmap(mem, fileSize);
+    prb_endTempMemory(temp);
+    close(fd);
+    return result;
+}
+
+// NOTE(khvorov) Every strategy with the cache warm and then dropped before each repeat, chunked ones at 4K to 4M.
+// Prints the fastest for both so the input stage can pick its strategy and chunk size from this
+function void
+repeatTestReadStrategies(Arena* arena, u64 freqPerSec, const char* path, u64 fileSize) {
+    prb_TempMemory temp = prb_beginTempMemory(arena);
+    u64            minChunk = 4 * prb_KILOBYTE;
+    u64            maxChunk = 4 * prb_MEGABYTE;
+    uint8_t*       whole = prb_arenaAllocAndZero(arena, fileSize, 4 * prb_KILOBYTE);
+    uint8_t*       chunkBuf = prb_arenaAllocAndZero(arena, maxChunk, 4 * prb_KILOBYTE);
+
+    int  directFd = open(path, O_RDONLY | O_DIRECT);
+    bool directSupported = directFd != -1;
+    if (directSupported) {
+        close(directFd);
+    }
+    u64  pageCount = (fileSize + 4 * prb_KILOBYTE - 1) / (4 * prb_KILOBYTE);
+    u64  residentAfterDrop = dropFromPageCache(arena, path, fileSize);
+    bool coldSupported = residentAfterDrop * 100 < pageCount;
+
+    struct {
+        u64          time;
+        ReadStrategy strategy;
+        u64          chunkSize;
+    } best[2] = {{.time = UINT64_MAX}, {.time = UINT64_MAX}};
+
+    for (int cold = 0; cold < 2; cold++) {
+        if (cold && !coldSupported) {
+            prb_writeToStdout(prb_fmt(arena, "cold: skipped, %llu of %llu pages stay cached after POSIX_FADV_DONTNEED\n",
+                (unsigned long long)residentAfterDrop, (unsigned long long)pageCount));
+            continue;
+        }
+        for (ReadStrategy strategy = 0; strategy < ReadStrategy_Count; strategy++) {
+            if (strategy == ReadStrategy_ChunkedDirect && !directSupported) {
+                continue;
+            }
+            bool chunked = readStrategyIsChunked(strategy);
+            for (u64 chunkSize = minChunk; chunkSize <= (chunked ? maxChunk : minChunk); chunkSize *= 4) {
+                RepetitionTester tester = createRepetitionTester(freqPerSec, fileSize);
+                tester.toWait = freqPerSec / 4;
+                uint8_t* buf = strategy == ReadStrategy_ReadAll ? whole : chunkBuf;
+                while (!repeatShouldStop(&tester)) {
+                    if (cold) {
+                        dropFromPageCache(arena, path, fileSize);
+                    }
+                    repeatBeginTime(&tester);
+                    readWithStrategy(path, fileSize, strategy, buf, chunkSize);
+                    repeatEndTime(&tester);
+                }
+
+                f64 sec = (f64)tester.minDiffTime / (f64)freqPerSec;
+                f64 gbPerSec = (f64)fileSize / (1024.0 * 1024.0 * 1024.0) / sec;
+                prb_Str chunkStr = chunked ? prb_fmt(arena, "%lluK", (unsigned long long)(chunkSize / prb_KILOBYTE)) : STR("-");
+                prb_writeToStdout(prb_fmt(arena,
+                    "%s %-18s %6.*s: %.2fgb/s %lluPF majorPF/run: %.2g\n",
+                    cold ? "cold" : "warm", globalReadStrategyNames[strategy], LIT(chunkStr), gbPerSec,
+                    (unsigned long long)tester.minDiffPF, (f64)tester.majorPFSum / (f64)tester.diffCount
+                ));
+
+                if (tester.minDiffTime < best[cold].time) {
+                    best[cold].time = tester.minDiffTime;
+                    best[cold].strategy = strategy;
+                    best[cold].chunkSize = chunked ? chunkSize : 0;
+                }
+            }
+        }
+    }
+
+    for (int cold = 0; cold < 2; cold++) {
+        if (best[cold].time != UINT64_MAX) {
+            f64     gbPerSec = (f64)fileSize / (1024.0 * 1024.0 * 1024.0) / ((f64)best[cold].time / (f64)freqPerSec);
+            prb_Str chunkStr = best[cold].chunkSize ? prb_fmt(arena, "%lluK", (unsigned long long)(best[cold].chunkSize / prb_KILOBYTE)) : STR("-");
+            prb_writeToStdout(prb_fmt(arena,
+                "best %s: %s chunk %.*s %.2fgb/s\n",
+                cold ? "cold" : "warm", globalReadStrategyNames[best[cold].strategy], LIT(chunkStr), gbPerSec
+            ));
+        }
+    }
+    prb_endTempMemory(temp);
+}
+#endif
+
+#if prb_PLATFORM_LINUX
+// NOTE(khvorov) pagemap has one u64 per virtual page: bit 63 present, bits 0-54 the PFN. The PFN reads as 0
+// without CAP_SYS_ADMIN but the present bit is always there. fd is -1 when the file can't be opened
+function u64
+readPagemapEntry(int pagemap, void* addr) {
+    u64 entry = 0;
+    if (pagemap != -1) {
+        ssize_t readResult = pread(pagemap, &entry, sizeof(entry), (off_t)((u64)addr / (4 * prb_KILOBYTE) * sizeof(entry)));
+        assert(readResult == sizeof(entry));
+    }
+    return entry;
+}
+
+function u64
+countPresentPages(int pagemap, uint8_t* mem, u64 pageCount) {
+    u64 result = 0;
+    if (pagemap != -1) {
+        u64 entries[512];
+        for (u64 first = 0; first < pageCount; first += prb_arrayCount(entries)) {
+            u64 count = prb_min(pageCount - first, prb_arrayCount(entries));
+            off_t offset = (off_t)(((u64)mem / (4 * prb_KILOBYTE) + first) * sizeof(u64));
+            ssize_t readResult = pread(pagemap, entries, count * sizeof(u64), offset);
+            assert(readResult == (ssize_t)(count * sizeof(u64)));
+            for (u64 ind = 0; ind < count; ind++) {
+                result += entries[ind] >> 63;
+            }
+        }
+    }
+    return result;
+}
+
+// NOTE(khvorov) proc and sys files don't report their real size so they can't go through prb_readEntireFile.
+// Trailing newline is dropped, empty string if the file can't be read
+function prb_Str
+readProcFile(Arena* arena, const char* path) {
+    prb_Str result = {};
+    int fd = open(path, O_RDONLY);
+    if (fd != -1) {
+        prb_GrowingStr gstr = prb_beginStr(arena);
+        for (;;) {
+            char chunk[4096];
+            ssize_t readResult = read(fd, chunk, sizeof(chunk));
+            if (readResult <= 0) {
+                break;
+            }
+            prb_addStrSegment(&gstr, "%.*s", (int)readResult, chunk);
+        }
+        close(fd);
+        result = prb_endStr(&gstr);
+        while (result.len > 0 && result.ptr[result.len - 1] == '\n') {
+            result.len -= 1;
+        }
+    }
+    return result;
+}
+
+// NOTE(khvorov) AnonHugePages of the smaps entry that contains addr, that's how much of it THP backs
+function u64
+readAnonHugePagesKB(Arena* arena, void* addr) {
+    u64 result = 0;
+    prb_TempMemory temp = prb_beginTempMemory(arena);
+    prb_Str smaps = readProcFile(arena, "/proc/self/smaps");
+    {
+        bool inside = false;
+        char* line = (char*)smaps.ptr;
+        char* end = line + smaps.len;
+        while (line < end) {
+            char* lineEnd = memchr(line, '\n', end - line);
+            lineEnd = lineEnd ? lineEnd : end;
+            char* rangeEnd = 0;
+            u64 begin = strtoull(line, &rangeEnd, 16);
+            if (rangeEnd != line && *rangeEnd == '-') {
+                u64 mapEnd = strtoull(rangeEnd + 1, 0, 16);
+                inside = (u64)addr >= begin && (u64)addr < mapEnd;
+            } else if (inside && strncmp(line, "AnonHugePages:", 14) == 0) {
+                result = strtoull(line + 14, 0, 10);
+                break;
+            }
+            line = lineEnd + 1;
+        }
+    }
+    prb_endTempMemory(temp);
+    return result;
+}
+#endif
+
 int
 main() {
     globalProfile.timeStart = __rdtsc();
@@ -465,6 +780,7 @@ main() {
     }
 
     // NOTE(khvorov) Create some pagefaults
+#if prb_PLATFORM_WINDOWS
     if (true) {
         u64 size = 100 * prb_MEGABYTE;
 
@@ -542,6 +858,179 @@ main() {
         }
     }
     ExitProcess(0);
+#elif prb_PLATFORM_LINUX
+    // NOTE(khvorov) Same study with mmap/munmap, the tester counts faults from rusage. The CSVs have the Windows
+    // columns first, then the pages pagemap says are present, the PFN of the first page and the THP backing.
+    // pf-faultaround.csv is the same forward walk over a file mapping already in the page cache, where the kernel
+    // maps up to fault_around_bytes of neighbours on every fault. Off by default since it exits when done,
+    // everything below it doesn't run when it's on
+    if (false) {
+        u64 size = 100 * prb_MEGABYTE;
+        int pagemap = open("/proc/self/pagemap", O_RDONLY);
+        u64 anonTouched = 0;
+        u64 anonPFs = 0;
+        u64 fileTouched = 0;
+        u64 filePFs = 0;
+        u64 filePresent = 0;
+
+        for (;;) {
+            prb_TempMemory temp = prb_beginTempMemory(arena);
+
+            if (false) {
+                RepetitionTester tester = createRepetitionTester(rdtscFrequencyPerSecond, size);
+                while (!repeatShouldStop(&tester)) {
+                    void* mem = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                    prb_assert(mem != MAP_FAILED);
+                    repeatBeginTime(&tester);
+                    prb_memset(mem, 0, size);
+                    repeatEndTime(&tester);
+                    prb_assert(munmap(mem, size) == 0);
+                }
+                repeatPrint(arena, &tester);
+            }
+
+            if (false) {
+                RepetitionTester tester = createRepetitionTester(rdtscFrequencyPerSecond, size);
+                void* mem = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                prb_assert(mem != MAP_FAILED);
+                prb_memset(mem, 0, size);
+                while (!repeatShouldStop(&tester)) {
+                    repeatBeginTime(&tester);
+                    prb_memset(mem, 0, size);
+                    repeatEndTime(&tester);
+                }
+                prb_assert(munmap(mem, size) == 0);
+                repeatPrint(arena, &tester);
+            }
+
+            if (true) {
+                // NOTE(khvorov) smaps gets read between touches so rows are formatted after the loop, the arena can't
+                // hold an open string then
+                typedef struct PFRow {
+                    u64 mem, pfs, present, pfn, thpKB;
+                } PFRow;
+                u64    rowCount = 4096;
+                PFRow* rows = prb_arenaAllocAndZero(arena, rowCount * sizeof(PFRow), prb_alignof(PFRow));
+                for (u64 toTouch = 0; toTouch < rowCount; toTouch++) {
+                    uint8_t* mem = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                    prb_assert(mem != MAP_FAILED);
+                    RepetitionTester tester = createRepetitionTester(rdtscFrequencyPerSecond, size);
+                    repeatBeginTime(&tester);
+                    prb_memset(mem, 0, toTouch * 4 * prb_KILOBYTE);
+                    repeatEndTime(&tester);
+
+                    // NOTE(khvorov) Looking a THP worth of pages past the touched ones catches whatever got mapped with them
+                    PFRow* row = rows + toTouch;
+                    row->mem = (u64)mem;
+                    row->pfs = tester.minDiffPF;
+                    row->present = countPresentPages(pagemap, mem, prb_min(toTouch + 512, size / (4 * prb_KILOBYTE)));
+                    row->pfn = readPagemapEntry(pagemap, mem) & ((1ULL << 55) - 1);
+                    row->thpKB = readAnonHugePagesKB(arena, mem);
+                    prb_assert(munmap(mem, size) == 0);
+                    anonTouched = toTouch;
+                    anonPFs = tester.minDiffPF;
+                }
+
+                prb_GrowingStr gstr = prb_beginStr(arena);
+                prb_addStrSegment(&gstr, "touched,pfs,t1,t2,t3,t4,offset,present,pfn,thpKB\n");
+                for (u64 toTouch = 0; toTouch < rowCount; toTouch++) {
+                    PFRow* row = rows + toTouch;
+                    prb_assert((row->mem & 0xFFFF000000000000ULL) == 0);
+                    uint16_t t1 = (row->mem >> (9 * 3 + 12));
+                    uint16_t t2 = (row->mem >> (9 * 2 + 12)) & 0x1FF;
+                    uint16_t t3 = (row->mem >> (9 + 12)) & 0x1FF;
+                    uint16_t t4 = (row->mem >> 12) & 0x1FF;
+                    uint16_t offset = row->mem & 0xFFF;
+
+                    prb_addStrSegment(
+                        &gstr, "%llu,%llu,%d,%d,%d,%d,%d,%llu,%llu,%llu\n",
+                        (unsigned long long)toTouch, (unsigned long long)row->pfs, t1, t2, t3, t4, offset,
+                        (unsigned long long)row->present, (unsigned long long)row->pfn, (unsigned long long)row->thpKB
+                    );
+                }
+                prb_Str csv = prb_endStr(&gstr);
+                prb_writeEntireFile(arena, prb_STR("pf-forward.csv"), csv.ptr, csv.len);
+            }
+
+            if (false) {
+                prb_GrowingStr gstr = prb_beginStr(arena);
+                prb_addStrSegment(&gstr, "touched,pfs,present\n");
+                for (u64 toTouch = 0; toTouch < 4096; toTouch++) {
+                    uint8_t* mem = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                    prb_assert(mem != MAP_FAILED);
+                    RepetitionTester tester = createRepetitionTester(rdtscFrequencyPerSecond, size);
+                    repeatBeginTime(&tester);
+                    for (u64 pageIndex = 0; pageIndex < toTouch; pageIndex++) {
+                        prb_memset(mem + ((toTouch - pageIndex - 1) * 4 * prb_KILOBYTE), 0, 4 * prb_KILOBYTE);
+                    }
+                    repeatEndTime(&tester);
+                    u64 present = countPresentPages(pagemap, mem, prb_min(toTouch + 512, size / (4 * prb_KILOBYTE)));
+                    prb_assert(munmap(mem, size) == 0);
+                    prb_addStrSegment(&gstr, "%llu,%llu,%llu\n", (unsigned long long)toTouch, (unsigned long long)tester.minDiffPF, (unsigned long long)present);
+                }
+                prb_Str csv = prb_endStr(&gstr);
+                prb_writeEntireFile(arena, prb_STR("pf-backward.csv"), csv.ptr, csv.len);
+            }
+
+            if (true) {
+                u64 fileSize = 4096 * 4 * prb_KILOBYTE;
+                uint8_t* content = prb_arenaAllocAndZero(arena, fileSize, 1);
+                prb_Str path = prb_STR("pf-faultaround.bin");
+                prb_writeEntireFile(arena, path, content, fileSize);
+                int fd = open((char*)path.ptr, O_RDONLY);
+                prb_assert(fd != -1);
+
+                prb_GrowingStr gstr = prb_beginStr(arena);
+                prb_addStrSegment(&gstr, "touched,pfs,present\n");
+                for (u64 toTouch = 0; toTouch < 4096; toTouch++) {
+                    volatile uint8_t* mem = mmap(0, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+                    prb_assert(mem != MAP_FAILED);
+                    RepetitionTester tester = createRepetitionTester(rdtscFrequencyPerSecond, fileSize);
+                    repeatBeginTime(&tester);
+                    for (u64 pageIndex = 0; pageIndex < toTouch; pageIndex++) {
+                        (void)mem[pageIndex * 4 * prb_KILOBYTE];
+                    }
+                    repeatEndTime(&tester);
+                    u64 present = countPresentPages(pagemap, (uint8_t*)mem, 4096);
+                    prb_assert(munmap((void*)mem, fileSize) == 0);
+                    prb_addStrSegment(&gstr, "%llu,%llu,%llu\n", (unsigned long long)toTouch, (unsigned long long)tester.minDiffPF, (unsigned long long)present);
+                    fileTouched = toTouch;
+                    filePFs = tester.minDiffPF;
+                    filePresent = present;
+                }
+                close(fd);
+                unlink((char*)path.ptr);
+                prb_Str csv = prb_endStr(&gstr);
+                prb_writeEntireFile(arena, prb_STR("pf-faultaround.csv"), csv.ptr, csv.len);
+            }
+
+            // NOTE(khvorov) Pages per fault is the batching, 1 for plain anonymous memory, up to 512 with THP and
+            // fault_around_bytes / 4K for a cached file (the debugfs knob is only readable as root)
+            prb_Str faultAround = readProcFile(arena, "/sys/kernel/debug/fault_around_bytes");
+            prb_Str thpEnabled = readProcFile(arena, "/sys/kernel/mm/transparent_hugepage/enabled");
+            faultAround = faultAround.len ? faultAround : prb_STR("no root");
+            thpEnabled = thpEnabled.len ? thpEnabled : prb_STR("unknown");
+            prb_writeToStdout(prb_fmt(arena,
+                "anon: %llu pages in %llu faults (%.3g pages/fault), file: %llu pages in %llu faults (%.3g pages/fault, %llu mapped)\n",
+                (unsigned long long)anonTouched, (unsigned long long)anonPFs, (f64)anonTouched / (f64)prb_max(anonPFs, 1),
+                (unsigned long long)fileTouched, (unsigned long long)filePFs, (f64)fileTouched / (f64)prb_max(filePFs, 1),
+                (unsigned long long)filePresent
+            ));
+            prb_writeToStdout(prb_fmt(arena,
+                "fault_around_bytes: %.*s, thp: %.*s, pagemap: %s\n",
+                LIT(faultAround), LIT(thpEnabled),
+                pagemap != -1 ? "yes" : "no"
+            ));
+
+            prb_endTempMemory(temp);
+            break;
+        }
+        if (pagemap != -1) {
+            close(pagemap);
+        }
+        exit(0);
+    }
+#endif
 
     Str rootDir = prb_getParentDir(arena, STR(__FILE__));
 
@@ -685,5 +1174,11 @@ main() {
     repeatTestReadFile(arena, &tester);
     repeatPrint(arena, &tester);
 
+#if prb_PLATFORM_LINUX
+    if (true) {
+        repeatTestReadStrategies(arena, rdtscFrequencyPerSecond, "input.json", input.json.len);
+    }
+#endif
+
     return 0;
 }
@@ -1,9 +1,22 @@
 #pragma clang diagnostic ignored "-Wunused-function"
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#ifndef _WIN32
+#include <x86intrin.h>
+#endif
+#include <cpuid.h>
 
 #define Byte 1
 #define Kilobyte 1024 * Byte
@@ -12,8 +25,14 @@
 
 #define STRINGIFY_(x) #x
 #define STRINGIFY(x) STRINGIFY_(x)
-#define assert(cond) do {if (cond) {} else {printf(__FILE__ ":" STRINGIFY(__LINE__) ":1: error: assertion failure"); __debugbreak();}} while (0)
+#ifdef _WIN32
+#define debugbreak() __debugbreak()
+#else
+#define debugbreak() __builtin_trap()
+#endif
+#define assert(cond) do {if (cond) {} else {printf(__FILE__ ":" STRINGIFY(__LINE__) ":1: error: assertion failure"); debugbreak();}} while (0)
 #define absval(x) ((x) < 0 ? -(x) : (x))
+#define arrayLen(arr) (i64)(sizeof(arr) / sizeof(*(arr)))
 
 typedef uint64_t u64;
 typedef uint32_t u32;
@@ -73,9 +92,24 @@ static void endTempMemory(TempMemory* mem) {
     *mem = (TempMemory) {};
 }
 
+// NOTE(khvorov) Every call site gets its own static anchor placed in a dedicated linker section,
+// so the section is the array of all anchors in the program regardless of how many translation units
+// it is built from. There is no lookup at runtime and no fixed capacity.
+// On windows the linker merges .pawpanc$* sections sorted by the suffix, and the $a/$z markers bracket the array.
+// Anchors are cache line aligned so that the compiler does not over-align some of them and break the stride.
+// The windows linker may still pad between entries, those are all zeroes and are skipped when iterating
+#ifdef _WIN32
+#define PROFILE_ANCHOR_SECTION __attribute__((section(".pawpanc$m"), used))
+#else
+#define PROFILE_ANCHOR_SECTION __attribute__((section("pawp_anchors"), used))
+#endif
+#define profileAnchorHere(anchorName) ({static ProfileAnchor __anchor__ PROFILE_ANCHOR_SECTION = {.name = {anchorName, sizeof(anchorName) - 1}}; &__anchor__;})
+
 #ifdef PAWP_PROFILE
-#define profileThroughputBegin(name, dataSize) profileThroughputBegin_(STR(name), __COUNTER__ + 1, dataSize)
-#define profileThroughput(name, dataSize) for (TimedSection __timedSection__ = profileThroughputBegin(name, dataSize); __timedSection__.anchorIndex; profileThroughputEnd(&__timedSection__))
+#define profileThroughputBegin(name, dataSize) profileThroughputBegin_(profileAnchorHere(name), dataSize, false)
+#define profileThroughputEnd(section) profileThroughputEnd_(section)
+#define profileThroughput(name, dataSize) for (TimedSection __timedSection__ = profileThroughputBegin(name, dataSize); __timedSection__.anchor; profileThroughputEnd_(&__timedSection__))
+#define profileThroughputHist(name, dataSize) for (TimedSection __timedSection__ = profileThroughputBegin_(profileAnchorHere(name), dataSize, true); __timedSection__.anchor; profileThroughputEnd_(&__timedSection__))
 #define profileSectionBegin(name) profileThroughputBegin(name, 0)
 #define profileSectionEnd(name) profileThroughputEnd(name)
 #define profileSection(name) profileSectionBegin(name); for (int _i_ = 0; _i_ == 0; _i_++, profileSectionEnd(name))
@@ -83,62 +117,356 @@ static void endTempMemory(TempMemory* mem) {
 #define profileThroughputBegin(name, dataSize)
 #define profileThroughputEnd(name)
 #define profileThroughput(name, dataSize)
+#define profileThroughputHist(name, dataSize)
 #define profileSectionBegin(name)
 #define profileSectionEnd(name)
 #define profileSection(name)
 #endif
 
+// NOTE(khvorov) Hardware counters are opened with perf_event_open on the calling thread.
+// They are read with rdpmc when the kernel allows it (perf_event_paranoid/rdpmc sysctl)
+// and with a read syscall otherwise. The profile itself is single threaded so only that thread is counted,
+// work on other threads (the scaling sweep workers) doesn't show up in any anchor
+#ifdef PAWP_PROFILE_PMC
+#ifndef __linux__
+#error PAWP_PROFILE_PMC is only implemented for linux
+#endif
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+typedef enum PmcKind {
+    PmcKind_Cycles,
+    PmcKind_Instructions,
+    PmcKind_BranchMisses,
+    PmcKind_L1DMisses,
+    PmcKind_LLCMisses,
+    PmcKind_DTLBMisses,
+    PmcKind_Count,
+} PmcKind;
+
+static char* globalPmcNames[PmcKind_Count] = {
+    [PmcKind_Cycles] = "cycles",
+    [PmcKind_Instructions] = "instr",
+    [PmcKind_BranchMisses] = "brmiss",
+    [PmcKind_L1DMisses] = "l1dmiss",
+    [PmcKind_LLCMisses] = "llcmiss",
+    [PmcKind_DTLBMisses] = "dtlbmiss",
+};
+
+typedef struct PmcCounter {
+    int fd;
+    bool useRdpmc;
+    struct perf_event_mmap_page* page;
+} PmcCounter;
+
+typedef struct ProfilePmc {
+    PmcKind kinds[PmcKind_Count];
+    i64 kindCount;
+    PmcCounter counters[PmcKind_Count];
+} ProfilePmc;
+#endif
+
+// NOTE(khvorov) Log-linear histogram of per-hit cycles: values below 2^PROFILE_HIST_SUB_BITS get their
+// own bucket, every power of two above that is split into 2^PROFILE_HIST_SUB_BITS buckets.
+// That bounds the relative error of a percentile to 1/2^PROFILE_HIST_SUB_BITS.
+// Histograms are only attached to anchors opened with profileThroughputHist and come from a fixed pool
+#define PROFILE_HIST_SUB_BITS 3
+#define PROFILE_HIST_BUCKET_COUNT ((64 - PROFILE_HIST_SUB_BITS + 1) << PROFILE_HIST_SUB_BITS)
+#define PROFILE_HIST_COUNT 64
+typedef struct ProfileHist {
+    u64 buckets[PROFILE_HIST_BUCKET_COUNT];
+    u64 min;
+    u64 max;
+} ProfileHist;
+
+static i64 profileHistBucket(u64 value) {
+    i64 result = (i64)value;
+    if (value >= (1 << PROFILE_HIST_SUB_BITS)) {
+        i64 msb = 63 - __builtin_clzll(value);
+        i64 shift = msb - PROFILE_HIST_SUB_BITS;
+        i64 mantissa = (value >> shift) & ((1 << PROFILE_HIST_SUB_BITS) - 1);
+        result = ((shift + 1) << PROFILE_HIST_SUB_BITS) + mantissa;
+    }
+    return result;
+}
+
+static u64 profileHistBucketUpperBound(i64 bucket) {
+    u64 result = (u64)bucket;
+    if (bucket >= (1 << PROFILE_HIST_SUB_BITS)) {
+        i64 shift = (bucket >> PROFILE_HIST_SUB_BITS) - 1;
+        u64 mantissa = (u64)(bucket & ((1 << PROFILE_HIST_SUB_BITS) - 1));
+        u64 lower = ((1ULL << PROFILE_HIST_SUB_BITS) + mantissa) << shift;
+        result = lower + ((1ULL << shift) - 1);
+    }
+    return result;
+}
+
+// NOTE(khvorov) Nearest rank, rounded up so that with few hits p99/p99.9 land on the slowest ones and not below them
+static u64 profileHistPercentile(ProfileHist* hist, u64 count, f64 percentile) {
+    u64 target = (u64)ceil((f64)count * percentile / 100.0);
+    target = target < 1 ? 1 : target;
+    u64 result = hist->max;
+    u64 cumulative = 0;
+    for (i64 bucket = 0; bucket < PROFILE_HIST_BUCKET_COUNT; bucket++) {
+        cumulative += hist->buckets[bucket];
+        if (cumulative >= target) {
+            u64 upper = profileHistBucketUpperBound(bucket);
+            result = upper < hist->max ? upper : hist->max;
+            break;
+        }
+    }
+    return result;
+}
+
 typedef struct ProfileAnchor {
     Str name;
+    ProfileHist* hist;
     u64 timeTakenSelf;
     u64 timeTakenWithChildren;
     i64 count;
     i64 dataSize;
-} ProfileAnchor;
+#ifdef PAWP_PROFILE_PMC
+    u64 pmcSelf[PmcKind_Count];
+    u64 pmcWithChildren[PmcKind_Count];
+#endif
+} __attribute__((aligned(64))) ProfileAnchor;
 
 typedef struct TimedSection {
     u64 timeBegin;
     u64 oldTimeWithChildren;
-    i64 anchorIndex;
-    i64 parentIndex;
+    ProfileAnchor* anchor;
+    ProfileAnchor* parent;
+#ifdef PAWP_PROFILE_PMC
+    u64 pmcBegin[PmcKind_Count];
+    u64 oldPmcWithChildren[PmcKind_Count];
+#endif
 } TimedSection;
 
-#define PROFILE_ANCHOR_COUNT 1024
 typedef struct Profile {
     u64 timeStart;
-    i64 currentOpenIndex;
-    ProfileAnchor anchors[PROFILE_ANCHOR_COUNT];
+    ProfileAnchor* currentOpen;
+    ProfileAnchor root;
+    ProfileHist hists[PROFILE_HIST_COUNT];
+    i64 histsUsed;
+#ifdef PAWP_PROFILE_PMC
+    ProfilePmc pmc;
+#endif
 } Profile;
 
-static Profile globalProfile;
+// NOTE(khvorov) Weak so that every translation unit that includes the profiler shares one profile
+#ifdef _WIN32
+#define PROFILE_SHARED __declspec(selectany)
+__attribute__((section(".pawpanc$a"), used)) static ProfileAnchor globalProfileAnchorsBegin;
+__attribute__((section(".pawpanc$z"), used)) static ProfileAnchor globalProfileAnchorsEnd;
+#define profileAnchorsFirst() (&globalProfileAnchorsBegin + 1)
+#define profileAnchorsOnePast() (&globalProfileAnchorsEnd)
+#else
+#define PROFILE_SHARED __attribute__((weak))
+extern ProfileAnchor __start_pawp_anchors[] __attribute__((weak));
+extern ProfileAnchor __stop_pawp_anchors[] __attribute__((weak));
+#define profileAnchorsFirst() (__start_pawp_anchors)
+#define profileAnchorsOnePast() (__stop_pawp_anchors)
+#endif
+
+PROFILE_SHARED Profile globalProfile = {.currentOpen = &globalProfile.root};
+
+#ifdef PAWP_PROFILE_PMC
+static struct perf_event_attr pmcAttr(PmcKind kind) {
+    struct perf_event_attr attr = {
+        .size = sizeof(attr),
+        .exclude_kernel = 1,
+        .exclude_hv = 1,
+        .read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING,
+    };
+    u64 cacheReadMiss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    switch (kind) {
+        case PmcKind_Cycles: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+        case PmcKind_Instructions: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+        case PmcKind_BranchMisses: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+        case PmcKind_L1DMisses: attr.type = PERF_TYPE_HW_CACHE; attr.config = PERF_COUNT_HW_CACHE_L1D | cacheReadMiss; break;
+        case PmcKind_LLCMisses: attr.type = PERF_TYPE_HW_CACHE; attr.config = PERF_COUNT_HW_CACHE_LL | cacheReadMiss; break;
+        case PmcKind_DTLBMisses: attr.type = PERF_TYPE_HW_CACHE; attr.config = PERF_COUNT_HW_CACHE_DTLB | cacheReadMiss; break;
+        case PmcKind_Count: assert(!"unreachable"); break;
+    }
+    return attr;
+}
+
+// NOTE(khvorov) All counters go into one group so that they are scheduled onto the PMU together.
+// Returns false (and leaves the profile without counters) when the kernel refuses any of them
+static bool profileOpenCounters(PmcKind* kinds, i64 kindCount) {
+    assert(kindCount <= PmcKind_Count);
+    ProfilePmc* pmc = &globalProfile.pmc;
+    int leaderFd = -1;
+    bool success = true;
+    for (i64 ind = 0; ind < kindCount && success; ind++) {
+        PmcKind kind = kinds[ind];
+        struct perf_event_attr attr = pmcAttr(kind);
+        attr.disabled = leaderFd == -1;
+        int fd = syscall(SYS_perf_event_open, &attr, 0, -1, leaderFd, 0);
+        if (fd == -1) {
+            printf("perf_event_open failed for %s, hardware counters disabled\n", globalPmcNames[kind]);
+            success = false;
+            break;
+        }
+        if (leaderFd == -1) {
+            leaderFd = fd;
+        }
+
+        PmcCounter* counter = pmc->counters + kind;
+        counter->fd = fd;
+        void* page = mmap(0, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fd, 0);
+        if (page != MAP_FAILED) {
+            counter->page = page;
+            counter->useRdpmc = counter->page->cap_user_rdpmc;
+        }
+        pmc->kinds[pmc->kindCount++] = kind;
+    }
+
+    if (success) {
+        ioctl(leaderFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leaderFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    } else {
+        for (i64 ind = 0; ind < pmc->kindCount; ind++) {
+            PmcCounter* counter = pmc->counters + pmc->kinds[ind];
+            if (counter->page) {
+                munmap(counter->page, sysconf(_SC_PAGESIZE));
+            }
+            close(counter->fd);
+        }
+        *pmc = (ProfilePmc) {};
+    }
+    return success;
+}
+
+// NOTE(khvorov) Comma separated counter names (see globalPmcNames) like PAWP_PROFILE_PMC_EVENTS=cycles,instr,brmiss,
+// unknown and repeated names are dropped. Returns the kind count
+static i64 pmcParseKinds(char* list, PmcKind* kinds) {
+    i64 result = 0;
+    for (char* name = list; *name;) {
+        i64 nameLen = strcspn(name, ",");
+        bool found = false;
+        for (PmcKind kind = 0; kind < PmcKind_Count && !found; kind++) {
+            if ((i64)strlen(globalPmcNames[kind]) == nameLen && memcmp(globalPmcNames[kind], name, nameLen) == 0) {
+                found = true;
+                bool repeated = false;
+                for (i64 ind = 0; ind < result; ind++) {
+                    repeated = repeated || kinds[ind] == kind;
+                }
+                if (!repeated) {
+                    kinds[result++] = kind;
+                }
+            }
+        }
+        if (!found) {
+            printf("unknown hardware counter %.*s\n", (int)nameLen, name);
+        }
+        name += nameLen + (name[nameLen] == ',');
+    }
+    return result;
+}
+
+static u64 pmcRead(PmcCounter* counter) {
+    u64 result = 0;
+    bool done = false;
+    if (counter->useRdpmc) {
+        // NOTE(khvorov) Seqlock protocol from the perf_event_mmap_page comment in linux/perf_event.h
+        struct perf_event_mmap_page* page = counter->page;
+        u32 seq = 0;
+        do {
+            seq = page->lock;
+            __asm__ volatile("" ::: "memory");
+            u32 index = page->index;
+            if (index != 0) {
+                u32 width = page->pmc_width;
+                u64 raw = __rdpmc(index - 1);
+                i64 value = (i64)(raw << (64 - width)) >> (64 - width);
+                result = page->offset + value;
+                done = true;
+            }
+            __asm__ volatile("" ::: "memory");
+        } while (page->lock != seq);
+    }
+    if (!done) {
+        u64 values[3] = {};
+        ssize_t readResult = read(counter->fd, values, sizeof(values));
+        assert(readResult == sizeof(values));
+        result = values[0];
+    }
+    return result;
+}
+
+// NOTE(khvorov) Fraction of the time the group was enabled that it actually sat on the PMU. The whole group is
+// scheduled in and out together, so anything under 1 means the kernel multiplexed it with other events and every
+// anchor lost counts for whatever part of it ran while the group was out. Scaling by a global ratio would be
+// wrong per anchor, so the report drops the counts instead
+static f64 pmcRunningFraction(void) {
+    ProfilePmc* pmc = &globalProfile.pmc;
+    u64 values[3] = {};
+    ssize_t readResult = read(pmc->counters[pmc->kinds[0]].fd, values, sizeof(values));
+    assert(readResult == sizeof(values));
+    f64 result = values[1] > 0 ? (f64)values[2] / (f64)values[1] : 1.0;
+    return result;
+}
+#endif
 
-static TimedSection profileThroughputBegin_(Str name, i64 index, i64 dataSize) {
-    assert(index < PROFILE_ANCHOR_COUNT);
-    ProfileAnchor* anchor = globalProfile.anchors + index;
-    anchor->name = name;
+static TimedSection profileThroughputBegin_(ProfileAnchor* anchor, i64 dataSize, bool withHist) {
     anchor->dataSize += dataSize;
+    if (withHist && anchor->hist == 0 && globalProfile.histsUsed < PROFILE_HIST_COUNT) {
+        anchor->hist = globalProfile.hists + globalProfile.histsUsed++;
+        anchor->hist->min = UINT64_MAX;
+    }
     TimedSection section = {
-        __rdtsc(),
-        anchor->timeTakenWithChildren,
-        index,
-        globalProfile.currentOpenIndex,
+        .oldTimeWithChildren = anchor->timeTakenWithChildren,
+        .anchor = anchor,
+        .parent = globalProfile.currentOpen,
     };
-    globalProfile.currentOpenIndex = index;
+    globalProfile.currentOpen = anchor;
+#ifdef PAWP_PROFILE_PMC
+    for (i64 ind = 0; ind < globalProfile.pmc.kindCount; ind++) {
+        PmcKind kind = globalProfile.pmc.kinds[ind];
+        section.oldPmcWithChildren[kind] = anchor->pmcWithChildren[kind];
+        section.pmcBegin[kind] = pmcRead(globalProfile.pmc.counters + kind);
+    }
+#endif
+    section.timeBegin = __rdtsc();
     return section;
 }
 
-static void profileThroughputEnd(TimedSection* section) {
-    ProfileAnchor* parent = globalProfile.anchors + section->parentIndex;
-    ProfileAnchor* anchor = globalProfile.anchors + section->anchorIndex;
+static void profileThroughputEnd_(TimedSection* section) {
+    u64 timeEnd = __rdtsc();
+    ProfileAnchor* parent = section->parent;
+    ProfileAnchor* anchor = section->anchor;
     assert(anchor->name.ptr);
     anchor->count += 1;
 
-    u64 diff = __rdtsc() - section->timeBegin;
+    u64 diff = timeEnd - section->timeBegin;
     anchor->timeTakenSelf += diff;
     anchor->timeTakenWithChildren = section->oldTimeWithChildren + diff;
     parent->timeTakenSelf -= diff;
 
-    globalProfile.currentOpenIndex = section->parentIndex;
+    ProfileHist* hist = anchor->hist;
+    if (hist) {
+        hist->buckets[profileHistBucket(diff)] += 1;
+        hist->min = diff < hist->min ? diff : hist->min;
+        hist->max = diff > hist->max ? diff : hist->max;
+    }
+
+#ifdef PAWP_PROFILE_PMC
+    for (i64 ind = 0; ind < globalProfile.pmc.kindCount; ind++) {
+        PmcKind kind = globalProfile.pmc.kinds[ind];
+        u64 pmcDiff = pmcRead(globalProfile.pmc.counters + kind) - section->pmcBegin[kind];
+        anchor->pmcSelf[kind] += pmcDiff;
+        anchor->pmcWithChildren[kind] = section->oldPmcWithChildren[kind] + pmcDiff;
+        parent->pmcSelf[kind] -= pmcDiff;
+    }
+#endif
+
+    globalProfile.currentOpen = parent;
     *section = (TimedSection) {};
 }
 
@@ -148,18 +476,191 @@ static void addTime(StrBuilder* gstr, u64 total, u64 freqPerSec, u64 diff) {
     buildStr(gstr, "%llu %.2gs %.2g%%", (unsigned long long)(diff), diffSec, prop * 100.0);
 }
 
-static void profileEnd(Arena* arena, u64 rdtscFrequencyPerSecond) { tempMemBlock(arena) {
+typedef struct ProfileReportSpec {
+    char* resultsPath;
+    char* baselinePath;
+    f64 thresholdPercent;
+} ProfileReportSpec;
+
+// NOTE(khvorov) Results are appended as csv rows, one per anchor, so that a file accumulates
+// several runs. A baseline made from several runs lets the comparison estimate run-to-run noise
+static void profileWriteResults(char* path, u64 rdtscFrequencyPerSecond) {
+    FILE* file = fopen(path, "ab");
+    assert(file);
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0) {
+        fprintf(file, "run,name,cycles,cyclesSelf,count,bytes,tscFreq\n");
+    }
+    unsigned long long run = (unsigned long long)time(0);
+    for (ProfileAnchor* anchor = profileAnchorsFirst(); anchor < profileAnchorsOnePast(); anchor++) {
+        if (anchor->count == 0) {
+            continue;
+        }
+        assert(memchr(anchor->name.ptr, ',', anchor->name.len) == 0);
+        fprintf(
+            file,
+            "%llu,%.*s,%llu,%llu,%lld,%lld,%llu\n",
+            run,
+            LIT(anchor->name),
+            (unsigned long long)anchor->timeTakenWithChildren,
+            (unsigned long long)anchor->timeTakenSelf,
+            (long long)anchor->count,
+            (long long)anchor->dataSize,
+            (unsigned long long)rdtscFrequencyPerSecond
+        );
+    }
+    fclose(file);
+}
+
+typedef struct ProfileBaselineEntry {
+    Str name;
+    i64 runCount;
+    f64 meanSec;
+    f64 m2;
+} ProfileBaselineEntry;
+
+static Str strSplitNext(Str* str, char sep) {
+    Str result = *str;
+    for (i64 ind = 0; ind < str->len; ind++) {
+        if (str->ptr[ind] == sep) {
+            result.len = ind;
+            break;
+        }
+    }
+    i64 consumed = result.len < str->len ? result.len + 1 : result.len;
+    str->ptr += consumed;
+    str->len -= consumed;
+    return result;
+}
+
+static bool strEq(Str str1, Str str2) {
+    bool result = str1.len == str2.len && memcmp(str1.ptr, str2.ptr, str1.len) == 0;
+    return result;
+}
+
+static void profileCompareBaseline(Arena* arena, StrBuilder* gstr, char* path, f64 thresholdPercent, u64 rdtscFrequencyPerSecond) {
+    FILE* file = fopen(path, "rb");
+    if (file == 0) {
+        buildStr(gstr, "could not open baseline %s\n", path);
+        return;
+    }
+    fseek(file, 0, SEEK_END);
+    i64 fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    Str content = {.len = fileSize};
+    content.ptr = arenaAllocArray(arena, char, content.len + 1);
+    i64 bytesRead = (i64)fread(content.ptr, 1, content.len, file);
+    assert(bytesRead == content.len);
+    content.ptr[content.len] = '\0';
+    fclose(file);
+
+    i64 lineCount = 0;
+    for (i64 ind = 0; ind < content.len; ind++) {
+        lineCount += content.ptr[ind] == '\n';
+    }
+    ProfileBaselineEntry* entries = arenaAllocArray(arena, ProfileBaselineEntry, lineCount);
+    i64 entryCount = 0;
+
+    strSplitNext(&content, '\n');
+    while (content.len > 0) {
+        Str line = strSplitNext(&content, '\n');
+        strSplitNext(&line, ',');
+        Str name = strSplitNext(&line, ',');
+        Str cycles = strSplitNext(&line, ',');
+        strSplitNext(&line, ',');
+        strSplitNext(&line, ',');
+        strSplitNext(&line, ',');
+        Str tscFreq = strSplitNext(&line, ',');
+        if (tscFreq.len == 0) {
+            continue;
+        }
+        f64 sec = strtod(cycles.ptr, 0) / strtod(tscFreq.ptr, 0);
+
+        ProfileBaselineEntry* entry = 0;
+        for (i64 ind = 0; ind < entryCount; ind++) {
+            if (strEq(entries[ind].name, name)) {
+                entry = entries + ind;
+                break;
+            }
+        }
+        if (entry == 0) {
+            entry = entries + entryCount++;
+            *entry = (ProfileBaselineEntry) {.name = name};
+        }
+
+        // NOTE(khvorov) Welford
+        entry->runCount += 1;
+        f64 delta = sec - entry->meanSec;
+        entry->meanSec += delta / (f64)entry->runCount;
+        entry->m2 += delta * (sec - entry->meanSec);
+    }
+
+    buildStr(gstr, "\ncompared to %s (threshold %.2g%%):\n", path, thresholdPercent);
+    for (ProfileAnchor* anchor = profileAnchorsFirst(); anchor < profileAnchorsOnePast(); anchor++) {
+        if (anchor->count == 0) {
+            continue;
+        }
+        ProfileBaselineEntry* entry = 0;
+        for (i64 entryIndex = 0; entryIndex < entryCount; entryIndex++) {
+            if (strEq(entries[entryIndex].name, anchor->name)) {
+                entry = entries + entryIndex;
+                break;
+            }
+        }
+        if (entry == 0) {
+            buildStr(gstr, "%.*s: not in baseline\n", LIT(anchor->name));
+            continue;
+        }
+
+        f64 sec = (f64)anchor->timeTakenWithChildren / (f64)rdtscFrequencyPerSecond;
+        f64 deltaPercent = (sec - entry->meanSec) / entry->meanSec * 100.0;
+        f64 noisePercent = 0;
+        if (entry->runCount > 1) {
+            noisePercent = sqrt(entry->m2 / (f64)(entry->runCount - 1)) / entry->meanSec * 100.0;
+        }
+        f64 limitPercent = thresholdPercent > 3.0 * noisePercent ? thresholdPercent : 3.0 * noisePercent;
+        char* flag = "";
+        if (deltaPercent > limitPercent) {
+            flag = " SLOWER";
+        } else if (deltaPercent < -limitPercent) {
+            flag = " FASTER";
+        }
+        buildStr(
+            gstr,
+            "%.*s: %.4gs -> %.4gs %+.2f%% (noise %.2f%% over %lld runs)%s\n",
+            LIT(anchor->name),
+            entry->meanSec,
+            sec,
+            deltaPercent,
+            noisePercent,
+            (long long)entry->runCount,
+            flag
+        );
+    }
+}
+
+static void profileEnd(Arena* arena, u64 rdtscFrequencyPerSecond, ProfileReportSpec spec) { tempMemBlock(arena) {
     u64 timeEnd = __rdtsc();
-    StrBuilder gstr = {.cap = arenaFreesize(arena) / sizeof(char)};
+    // NOTE(khvorov) The string builder takes the rest of the arena, or half of it when the baseline has to be read into the other half
+    i64 reportSize = spec.baselinePath ? arenaFreesize(arena) / 2 : arenaFreesize(arena);
+    StrBuilder gstr = {.cap = reportSize / sizeof(char)};
     gstr.ptr = arenaAllocArray(arena, char, gstr.cap);
     buildStr(&gstr, "\n");
     u64 total = timeEnd - globalProfile.timeStart;
-    for (i64 ind = 1; ind < PROFILE_ANCHOR_COUNT; ind++) {
-        ProfileAnchor* anchor = globalProfile.anchors + ind;
-        if (anchor->name.ptr == 0) {
-            break;
+#ifdef PAWP_PROFILE_PMC
+    bool pmcReport = globalProfile.pmc.kindCount > 0;
+    if (pmcReport) {
+        f64 runningFraction = pmcRunningFraction();
+        if (runningFraction < 1.0) {
+            buildStr(&gstr, "hardware counters were multiplexed (on the PMU %.1f%% of the time), not reporting them\n", runningFraction * 100.0);
+            pmcReport = false;
+        }
+    }
+#endif
+    for (ProfileAnchor* anchor = profileAnchorsFirst(); anchor < profileAnchorsOnePast(); anchor++) {
+        if (anchor->count == 0) {
+            continue;
         }
-        assert(anchor->count > 0);
         buildStr(&gstr, "%.*s: ", LIT(anchor->name));
         addTime(&gstr, total, rdtscFrequencyPerSecond, anchor->timeTakenWithChildren);
         if (anchor->timeTakenWithChildren - anchor->timeTakenSelf > 0) {
@@ -179,12 +680,337 @@ static void profileEnd(Arena* arena, u64 rdtscFrequencyPerSecond) { tempMemBlock
             f64 gbPerSec = dataSizeGB / seconds;
             buildStr(&gstr, " data: %.2fMB, throughput: %.2fgb/s", dataSizeMB, gbPerSec);
         }
+#ifdef PAWP_PROFILE_PMC
+        ProfilePmc* pmc = &globalProfile.pmc;
+        if (pmcReport) {
+            u64* counts = anchor->pmcWithChildren;
+            bool haveKind[PmcKind_Count] = {};
+            for (i64 kindIndex = 0; kindIndex < pmc->kindCount; kindIndex++) {
+                PmcKind kind = pmc->kinds[kindIndex];
+                haveKind[kind] = true;
+                buildStr(&gstr, " %s: %llu", globalPmcNames[kind], (unsigned long long)counts[kind]);
+            }
+            if (anchor->timeTakenWithChildren - anchor->timeTakenSelf > 0) {
+                buildStr(&gstr, " excl");
+                for (i64 kindIndex = 0; kindIndex < pmc->kindCount; kindIndex++) {
+                    PmcKind kind = pmc->kinds[kindIndex];
+                    buildStr(&gstr, " %s: %llu", globalPmcNames[kind], (unsigned long long)anchor->pmcSelf[kind]);
+                }
+            }
+            if (haveKind[PmcKind_Cycles] && haveKind[PmcKind_Instructions] && counts[PmcKind_Cycles] > 0) {
+                buildStr(&gstr, " ipc: %.2f", (f64)counts[PmcKind_Instructions] / (f64)counts[PmcKind_Cycles]);
+            }
+            if (anchor->dataSize > 0) {
+                f64 dataSizeKB = (f64)anchor->dataSize / 1024.0;
+                PmcKind missKinds[] = {PmcKind_L1DMisses, PmcKind_LLCMisses, PmcKind_DTLBMisses};
+                for (i64 missIndex = 0; missIndex < arrayLen(missKinds); missIndex++) {
+                    PmcKind kind = missKinds[missIndex];
+                    if (haveKind[kind]) {
+                        buildStr(&gstr, " %s/KB: %.2f", globalPmcNames[kind], (f64)counts[kind] / dataSizeKB);
+                    }
+                }
+            }
+            if (haveKind[PmcKind_BranchMisses]) {
+                buildStr(&gstr, " brmiss/record: %.2f", (f64)counts[PmcKind_BranchMisses] / (f64)anchor->count);
+            }
+        }
+#endif
         buildStr(&gstr, "\n");
+        if (anchor->hist) {
+            ProfileHist* hist = anchor->hist;
+            u64 count = (u64)anchor->count;
+            buildStr(
+                &gstr,
+                "    cycles min: %llu p50: %llu p90: %llu p99: %llu p99.9: %llu max: %llu\n",
+                (unsigned long long)hist->min,
+                (unsigned long long)profileHistPercentile(hist, count, 50.0),
+                (unsigned long long)profileHistPercentile(hist, count, 90.0),
+                (unsigned long long)profileHistPercentile(hist, count, 99.0),
+                (unsigned long long)profileHistPercentile(hist, count, 99.9),
+                (unsigned long long)hist->max
+            );
+        }
     }
     buildStr(&gstr, "total: %llu %.2gs\n", (unsigned long long)total, (f64)total / (f64)rdtscFrequencyPerSecond);
+    if (spec.baselinePath) {
+        profileCompareBaseline(arena, &gstr, spec.baselinePath, spec.thresholdPercent, rdtscFrequencyPerSecond);
+    }
+    if (spec.resultsPath) {
+        profileWriteResults(spec.resultsPath, rdtscFrequencyPerSecond);
+    }
+    Str msg = {gstr.ptr, gstr.len};
+    printf("%.*s", LIT(msg));
+}}
+
+// NOTE(khvorov) Statistical sampling with SIGPROF. The handler only records the interrupted
+// instruction pointer together with the open anchor, symbolization happens at the end
+// from the symbol tables of the executable and the shared objects it has loaded
+#ifdef PAWP_PROFILE_SAMPLE
+#ifndef __linux__
+#error PAWP_PROFILE_SAMPLE is only implemented for linux
+#endif
+
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+typedef struct ProfileSample {
+    u64 ip;
+    ProfileAnchor* anchor;
+} ProfileSample;
+
+#define PROFILE_SAMPLE_COUNT (1 << 18)
+typedef struct ProfileSampler {
+    ProfileSample samples[PROFILE_SAMPLE_COUNT];
+    i64 sampleCount;
+} ProfileSampler;
+
+static ProfileSampler globalSampler;
+
+static void profileSampleHandler(int sig, siginfo_t* info, void* context) {
+    (void)sig;
+    (void)info;
+    ucontext_t* ucontext = context;
+    i64 slot = __atomic_fetch_add(&globalSampler.sampleCount, 1, __ATOMIC_RELAXED);
+    if (slot < PROFILE_SAMPLE_COUNT) {
+        globalSampler.samples[slot] = (ProfileSample) {(u64)ucontext->uc_mcontext.gregs[REG_RIP], globalProfile.currentOpen};
+    }
+}
+
+static void profileSamplingBegin(i64 intervalMicroseconds) {
+    struct sigaction action = {.sa_sigaction = profileSampleHandler, .sa_flags = SA_SIGINFO | SA_RESTART};
+    sigemptyset(&action.sa_mask);
+    int sigactionResult = sigaction(SIGPROF, &action, 0);
+    assert(sigactionResult == 0);
+
+    struct timeval interval = {.tv_sec = intervalMicroseconds / 1000000, .tv_usec = intervalMicroseconds % 1000000};
+    struct itimerval timer = {.it_interval = interval, .it_value = interval};
+    int setitimerResult = setitimer(ITIMER_PROF, &timer, 0);
+    assert(setitimerResult == 0);
+}
+
+typedef struct SampleSymbol {
+    u64 begin;
+    u64 end;
+    char* name;
+} SampleSymbol;
+
+typedef struct SampleModule {
+    char path[256];
+    u64 bias;
+    u64 begin;
+    u64 end;
+    void* file;
+    i64 fileSize;
+} SampleModule;
+
+#define SAMPLE_MODULE_COUNT 64
+typedef struct SampleModules {
+    SampleModule modules[SAMPLE_MODULE_COUNT];
+    i64 count;
+} SampleModules;
+
+static int sampleModuleCallback(struct dl_phdr_info* info, size_t size, void* data) {
+    (void)size;
+    SampleModules* modules = data;
+    if (modules->count < SAMPLE_MODULE_COUNT) {
+        SampleModule* module = modules->modules + modules->count++;
+        char* path = info->dlpi_name && info->dlpi_name[0] ? (char*)info->dlpi_name : "/proc/self/exe";
+        snprintf(module->path, sizeof(module->path), "%s", path);
+        module->bias = info->dlpi_addr;
+        module->begin = UINT64_MAX;
+        for (i64 ind = 0; ind < info->dlpi_phnum; ind++) {
+            const ElfW(Phdr)* phdr = info->dlpi_phdr + ind;
+            if (phdr->p_type == PT_LOAD) {
+                u64 segBegin = info->dlpi_addr + phdr->p_vaddr;
+                u64 segEnd = segBegin + phdr->p_memsz;
+                module->begin = segBegin < module->begin ? segBegin : module->begin;
+                module->end = segEnd > module->end ? segEnd : module->end;
+            }
+        }
+    }
+    return 0;
+}
+
+// NOTE(khvorov) Appends function symbols of the module to the arena, symbols end up contiguous
+// as long as nothing else is allocated from the arena in between
+static i64 sampleLoadSymbols(Arena* arena, SampleModule* module) {
+    i64 result = 0;
+    int fd = open(module->path, O_RDONLY);
+    if (fd != -1) {
+        struct stat st = {};
+        if (fstat(fd, &st) == 0 && st.st_size >= (i64)sizeof(Elf64_Ehdr)) {
+            void* file = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (file != MAP_FAILED) {
+                module->file = file;
+                module->fileSize = st.st_size;
+                Elf64_Ehdr* header = file;
+                Elf64_Shdr* sections = file + header->e_shoff;
+                bool isElf64 = header->e_ident[EI_CLASS] == ELFCLASS64 && header->e_shoff + header->e_shnum * sizeof(Elf64_Shdr) <= (u64)st.st_size;
+                Elf64_Shdr* symtab = 0;
+                for (i64 ind = 0; ind < header->e_shnum && isElf64; ind++) {
+                    if (sections[ind].sh_type == SHT_SYMTAB || (sections[ind].sh_type == SHT_DYNSYM && symtab == 0)) {
+                        symtab = sections + ind;
+                    }
+                }
+                if (symtab) {
+                    Elf64_Sym* syms = file + symtab->sh_offset;
+                    char* strings = file + sections[symtab->sh_link].sh_offset;
+                    i64 symCount = symtab->sh_size / sizeof(Elf64_Sym);
+                    for (i64 ind = 0; ind < symCount; ind++) {
+                        Elf64_Sym* sym = syms + ind;
+                        if (ELF64_ST_TYPE(sym->st_info) == STT_FUNC && sym->st_value != 0 && sym->st_size > 0) {
+                            SampleSymbol* symbol = arenaAllocArray(arena, SampleSymbol, 1);
+                            symbol->begin = module->bias + sym->st_value;
+                            symbol->end = symbol->begin + sym->st_size;
+                            symbol->name = strings + sym->st_name;
+                            result += 1;
+                        }
+                    }
+                }
+            }
+        }
+        close(fd);
+    }
+    return result;
+}
+
+static int sampleSymbolCompare(const void* lhs, const void* rhs) {
+    u64 left = ((SampleSymbol*)lhs)->begin;
+    u64 right = ((SampleSymbol*)rhs)->begin;
+    return left < right ? -1 : left > right;
+}
+
+typedef struct SampleBucket {
+    ProfileAnchor* anchor;
+    i64 key;
+    i64 count;
+} SampleBucket;
+
+static int sampleBucketCompareKey(const void* lhs, const void* rhs) {
+    SampleBucket* left = (SampleBucket*)lhs;
+    SampleBucket* right = (SampleBucket*)rhs;
+    int result = left->anchor < right->anchor ? -1 : left->anchor > right->anchor;
+    if (result == 0) {
+        result = left->key < right->key ? -1 : left->key > right->key;
+    }
+    return result;
+}
+
+static int sampleBucketCompareCount(const void* lhs, const void* rhs) {
+    SampleBucket* left = (SampleBucket*)lhs;
+    SampleBucket* right = (SampleBucket*)rhs;
+    int result = left->anchor < right->anchor ? -1 : left->anchor > right->anchor;
+    if (result == 0) {
+        result = left->count > right->count ? -1 : left->count < right->count;
+    }
+    return result;
+}
+
+// NOTE(khvorov) Samples are keyed by symbol index, ips outside any known symbol are keyed by
+// their module (negative key) so that time spent in stripped libraries is still accounted for
+static void profileSamplingEnd(Arena* arena, i64 topCount) { tempMemBlock(arena) {
+    struct itimerval timer = {};
+    setitimer(ITIMER_PROF, &timer, 0);
+    signal(SIGPROF, SIG_IGN);
+
+    i64 sampleCount = globalSampler.sampleCount < PROFILE_SAMPLE_COUNT ? globalSampler.sampleCount : PROFILE_SAMPLE_COUNT;
+    i64 droppedCount = globalSampler.sampleCount - sampleCount;
+
+    SampleModules* modules = arenaAllocArray(arena, SampleModules, 1);
+    *modules = (SampleModules) {};
+    dl_iterate_phdr(sampleModuleCallback, modules);
+
+    SampleSymbol* symbols = arenaFreeptr(arena);
+    i64 symbolCount = 0;
+    for (i64 ind = 0; ind < modules->count; ind++) {
+        symbolCount += sampleLoadSymbols(arena, modules->modules + ind);
+    }
+    qsort(symbols, symbolCount, sizeof(*symbols), sampleSymbolCompare);
+
+    SampleBucket* buckets = arenaAllocArray(arena, SampleBucket, sampleCount);
+    for (i64 sampleIndex = 0; sampleIndex < sampleCount; sampleIndex++) {
+        ProfileSample sample = globalSampler.samples[sampleIndex];
+        i64 key = -1 - SAMPLE_MODULE_COUNT;
+        i64 low = 0;
+        i64 high = symbolCount;
+        while (low < high) {
+            i64 mid = low + (high - low) / 2;
+            if (symbols[mid].begin <= sample.ip) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        if (low > 0 && sample.ip < symbols[low - 1].end) {
+            key = low - 1;
+        } else {
+            for (i64 moduleIndex = 0; moduleIndex < modules->count; moduleIndex++) {
+                SampleModule* module = modules->modules + moduleIndex;
+                if (sample.ip >= module->begin && sample.ip < module->end) {
+                    key = -1 - moduleIndex;
+                    break;
+                }
+            }
+        }
+        buckets[sampleIndex] = (SampleBucket) {sample.anchor, key, 1};
+    }
+
+    qsort(buckets, sampleCount, sizeof(*buckets), sampleBucketCompareKey);
+    i64 bucketCount = 0;
+    for (i64 sampleIndex = 0; sampleIndex < sampleCount; sampleIndex++) {
+        SampleBucket bucket = buckets[sampleIndex];
+        if (bucketCount > 0 && sampleBucketCompareKey(buckets + bucketCount - 1, &bucket) == 0) {
+            buckets[bucketCount - 1].count += 1;
+        } else {
+            buckets[bucketCount++] = bucket;
+        }
+    }
+    qsort(buckets, bucketCount, sizeof(*buckets), sampleBucketCompareCount);
+
+    StrBuilder gstr = {.cap = arenaFreesize(arena) / sizeof(char)};
+    gstr.ptr = arenaAllocArray(arena, char, gstr.cap);
+    buildStr(&gstr, "\nsamples: %lld dropped: %lld\n", (long long)sampleCount, (long long)droppedCount);
+    for (i64 bucketIndex = 0; bucketIndex < bucketCount;) {
+        ProfileAnchor* anchor = buckets[bucketIndex].anchor;
+        i64 anchorSamples = 0;
+        i64 anchorEnd = bucketIndex;
+        for (; anchorEnd < bucketCount && buckets[anchorEnd].anchor == anchor; anchorEnd++) {
+            anchorSamples += buckets[anchorEnd].count;
+        }
+
+        Str anchorName = anchor == &globalProfile.root ? STR("<no anchor>") : anchor->name;
+        buildStr(&gstr, "%.*s: %lld samples %.2g%%\n", LIT(anchorName), (long long)anchorSamples, (f64)anchorSamples / (f64)sampleCount * 100.0);
+        for (i64 ind = bucketIndex; ind < anchorEnd && ind - bucketIndex < topCount; ind++) {
+            SampleBucket bucket = buckets[ind];
+            char* name = "<unknown>";
+            if (bucket.key >= 0) {
+                name = symbols[bucket.key].name;
+            } else if (bucket.key >= -modules->count) {
+                name = modules->modules[-1 - bucket.key].path;
+            }
+            buildStr(&gstr, "    %lld %.2g%% %s\n", (long long)bucket.count, (f64)bucket.count / (f64)anchorSamples * 100.0, name);
+        }
+        bucketIndex = anchorEnd;
+    }
     Str msg = {gstr.ptr, gstr.len};
     printf("%.*s", LIT(msg));
+
+    for (i64 ind = 0; ind < modules->count; ind++) {
+        SampleModule* module = modules->modules + ind;
+        if (module->file) {
+            munmap(module->file, module->fileSize);
+        }
+    }
 }}
+#endif
 
 typedef struct Rng {
     u64 state;
@@ -250,8 +1076,6 @@ static f32 randomFraction(Rng* rng, f32 min) {
 static f64 square(f64 x) { return x * x; }
 static f64 degreesToRadians(f64 degrees) { return 0.01745329251994329577 * degrees; }
 
-#include <math.h>
-
 // From https://github.com/cmuratori/computer_enhance/blob/main/perfaware/part2/listing_0065_haversine_formula.cpp
 // NOTE(casey): EarthRadius is generally expected to be 6372.8
 static f64 haversineDistance(f64 X0, f64 Y0, f64 X1, f64 Y1, f64 EarthRadius) {
@@ -278,11 +1102,62 @@ static f64 haversineDistance(f64 X0, f64 Y0, f64 X1, f64 Y1, f64 EarthRadius) {
 
 typedef struct Pair { f64 x0, y0, x1, y1; } Pair;
 
+#ifdef _WIN32
 #include <windows.h>
 #include <psapi.h>
+#include <bcrypt.h>
 
 #pragma comment(lib, "advapi32")
 #pragma comment(lib, "bcrypt")
+#else
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/random.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef min
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+// NOTE(khvorov) Every run goes into the mean/variance, a uniform reservoir of runs is kept for the
+// order statistics so that memory stays fixed no matter how long the tester runs.
+// The reservoir and the bootstrap scratch come from the arena, the tester itself stays small enough to return
+// by value and testers on different threads share nothing
+#define REPEAT_SAMPLE_COUNT 4096
+#define REPEAT_BOOTSTRAP_COUNT 1000
+#define REPEAT_STOP_BOOTSTRAP_COUNT 200
+
+// NOTE(khvorov) value is seconds for min-unchanged and wall-time, a run count for iterations and
+// the width of the median 95% CI as a percentage of the median for median-ci.
+// capSec bounds the wall time of every policy, 0 means no cap
+typedef enum RepeatStopKind {
+    RepeatStopKind_MinUnchanged,
+    RepeatStopKind_Iterations,
+    RepeatStopKind_WallTime,
+    RepeatStopKind_MedianCI,
+    RepeatStopKind_Count,
+} RepeatStopKind;
+
+static char* globalRepeatStopKindNames[RepeatStopKind_Count] = {
+    [RepeatStopKind_MinUnchanged] = "min-unchanged",
+    [RepeatStopKind_Iterations] = "iterations",
+    [RepeatStopKind_WallTime] = "wall-time",
+    [RepeatStopKind_MedianCI] = "median-ci",
+};
+
+typedef struct RepeatStopPolicy {
+    RepeatStopKind kind;
+    f64 value;
+    f64 capSec;
+} RepeatStopPolicy;
+
+#define REPEAT_DEFAULT_STOP_POLICY ((RepeatStopPolicy) {.kind = RepeatStopKind_MinUnchanged, .value = 1, .capSec = 30})
 
 typedef struct RepetitionTester {
     Str name;
@@ -290,45 +1165,93 @@ typedef struct RepetitionTester {
     u64 toWait;
     u64 expectedSize;
 
+    RepeatStopPolicy policy;
+    u64 firstBegin;
+    u64 nextCICheck;
+    bool capped;
+
     u64 minDiffTime;
     u64 maxDiffTime;
     u64 diffTimeSum;
+    f64 diffTimeMean;
+    f64 diffTimeM2;
+
+    u64* samples;
+    i64 sampleCount;
+    i32* bootstrapCounts;
+    u64* bootstrapMedians;
+    Rng rng;
 
     u64 minDiffPF;
     u64 maxDiffPF;
+    u64 majorPFSum;
+    u64 contextSwitchSum;
+    u64 involuntaryContextSwitchSum;
 
     u64 diffCount;
 
     u64 lastBegin;
+    u64 lastDiffTime;
+#ifdef _WIN32
     PROCESS_MEMORY_COUNTERS lastCounters;
+#else
+    struct rusage lastUsage;
+#endif
 
     u64 waited;
 
+#ifdef _WIN32
     HANDLE process;
+#endif
 } RepetitionTester;
 
 static RepetitionTester
-createRepetitionTester(u64 freqPerSec, u64 expectedSize, Str name) {
+createRepetitionTester(Arena* arena, u64 freqPerSec, u64 expectedSize, Str name) {
     RepetitionTester tester = {
         .name = name,
         .freqPerSec = freqPerSec, .toWait = freqPerSec, .expectedSize = expectedSize, .minDiffTime = UINT64_MAX, .minDiffPF = UINT64_MAX,
-        .process = OpenProcess(PROCESS_QUERY_INFORMATION  | PROCESS_VM_READ, FALSE, GetCurrentProcessId())
+        .policy = REPEAT_DEFAULT_STOP_POLICY,
+        .samples = arenaAllocArray(arena, u64, REPEAT_SAMPLE_COUNT),
+        .bootstrapCounts = arenaAllocArray(arena, i32, REPEAT_SAMPLE_COUNT),
+        .bootstrapMedians = arenaAllocArray(arena, u64, REPEAT_BOOTSTRAP_COUNT),
+        .rng = createRng(expectedSize),
     };
+#ifdef _WIN32
+    tester.process = OpenProcess(PROCESS_QUERY_INFORMATION  | PROCESS_VM_READ, FALSE, GetCurrentProcessId());
     assert(tester.process);
+#endif
     return tester;
 }
 
+static void
+repeatSetStopPolicy(RepetitionTester* tester, RepeatStopPolicy policy) {
+    tester->policy = policy;
+    if (policy.kind == RepeatStopKind_MinUnchanged) {
+        tester->toWait = (u64)(policy.value * (f64)tester->freqPerSec);
+    }
+}
+
 static void
 repeatBeginTime(RepetitionTester* tester) {
-    tester->lastBegin = __rdtsc();
+#ifdef _WIN32
     BOOL GetProcessMemoryInfoResult = GetProcessMemoryInfo(tester->process, &tester->lastCounters, sizeof(tester->lastCounters));
     assert(GetProcessMemoryInfoResult);
+#else
+    // NOTE(khvorov) Per thread so that other threads of the process don't show up in the counts
+    int getrusageResult = getrusage(RUSAGE_THREAD, &tester->lastUsage);
+    assert(getrusageResult == 0);
+#endif
+    tester->lastBegin = __rdtsc();
+    if (tester->firstBegin == 0) {
+        tester->firstBegin = tester->lastBegin;
+    }
 }
 
 static void
 repeatEndTime(RepetitionTester* tester) {
     u64 time = __rdtsc();
     u64 diffTime = time - tester->lastBegin;
+    tester->lastDiffTime = diffTime;
     if (diffTime < tester->minDiffTime) {
         tester->minDiffTime = diffTime;
         tester->waited = 0;
@@ -342,80 +1265,2914 @@ repeatEndTime(RepetitionTester* tester) {
     tester->diffTimeSum += diffTime;
     tester->diffCount += 1;
 
+    // NOTE(khvorov) Welford
+    f64 delta = (f64)diffTime - tester->diffTimeMean;
+    tester->diffTimeMean += delta / (f64)tester->diffCount;
+    tester->diffTimeM2 += delta * ((f64)diffTime - tester->diffTimeMean);
+
+    if (tester->sampleCount < REPEAT_SAMPLE_COUNT) {
+        tester->samples[tester->sampleCount++] = diffTime;
+    } else {
+        u64 slot = randomU32Bound(&tester->rng, (u32)min(tester->diffCount, UINT32_MAX));
+        if (slot < REPEAT_SAMPLE_COUNT) {
+            tester->samples[slot] = diffTime;
+        }
+    }
+
+#ifdef _WIN32
     PROCESS_MEMORY_COUNTERS counters = {};
     BOOL GetProcessMemoryInfoResult = GetProcessMemoryInfo(tester->process, &counters, sizeof(counters));
     assert(GetProcessMemoryInfoResult);
 
     u64 diffPF = counters.PageFaultCount - tester->lastCounters.PageFaultCount;
+#else
+    struct rusage usage = {};
+    int getrusageResult = getrusage(RUSAGE_THREAD, &usage);
+    assert(getrusageResult == 0);
+
+    struct rusage* last = &tester->lastUsage;
+    u64 diffMajorPF = usage.ru_majflt - last->ru_majflt;
+    u64 diffPF = usage.ru_minflt - last->ru_minflt + diffMajorPF;
+    u64 diffInvoluntary = usage.ru_nivcsw - last->ru_nivcsw;
+    tester->majorPFSum += diffMajorPF;
+    tester->involuntaryContextSwitchSum += diffInvoluntary;
+    tester->contextSwitchSum += usage.ru_nvcsw - last->ru_nvcsw + diffInvoluntary;
+#endif
     tester->minDiffPF = min(tester->minDiffPF, diffPF);
     tester->maxDiffPF = max(tester->maxDiffPF, diffPF);
 }
 
-static bool
-repeatShouldStop(RepetitionTester* tester) {
-    bool result = tester->waited >= tester->toWait;
-    return result;
-}
+typedef struct RepeatStats {
+    f64 minSec;
+    f64 maxSec;
+    f64 meanSec;
+    f64 stddevSec;
+    f64 medianSec;
+    f64 medianLowSec;
+    f64 medianHighSec;
+    i64 outlierCount;
+    i64 sampleCount;
+} RepeatStats;
 
-static void
-repeatPrint(RepetitionTester* tester) {
-    f64 minSec = (f64)tester->minDiffTime / (f64)tester->freqPerSec;
-    f64 maxSec = (f64)tester->maxDiffTime / (f64)tester->freqPerSec;
+static int u64Compare(const void* lhs, const void* rhs) {
+    u64 left = *(u64*)lhs;
+    u64 right = *(u64*)rhs;
+    return left < right ? -1 : left > right;
+}
 
-    f64 sizeGB = (f64)tester->expectedSize / (1024.0 * 1024.0 * 1024.0);
-    f64 minBand = sizeGB / minSec;
-    f64 maxBand = sizeGB / maxSec;
+static int f64Compare(const void* lhs, const void* rhs) {
+    f64 left = *(f64*)lhs;
+    f64 right = *(f64*)rhs;
+    return left < right ? -1 : left > right;
+}
+
+// NOTE(khvorov) Percentile bootstrap 95% CI of the median of n sorted values. Resamples are drawn as index counts
+// over the sorted values so no resample has to be sorted, and the resample medians are ranked by index since
+// the values are sorted already. Returns the indices of the bounds, counts has room for n and medians for bootstrapCount
+static void bootstrapMedianCI(i64 n, i64 bootstrapCount, Rng* rng, i32* counts, u64* medians, i64* lowIndex, i64* highIndex) {
+    *lowIndex = n / 2;
+    *highIndex = n / 2;
+    if (n > 0 && bootstrapCount > 0) {
+        for (i64 bootIndex = 0; bootIndex < bootstrapCount; bootIndex++) {
+            memset(counts, 0, sizeof(*counts) * n);
+            for (i64 ind = 0; ind < n; ind++) {
+                counts[randomU32Bound(rng, (u32)n)] += 1;
+            }
+            i64 cumulative = 0;
+            i64 medianIndex = 0;
+            for (; medianIndex < n; medianIndex++) {
+                cumulative += counts[medianIndex];
+                if (cumulative > n / 2) {
+                    break;
+                }
+            }
+            medians[bootIndex] = medianIndex;
+        }
+        qsort(medians, bootstrapCount, sizeof(*medians), u64Compare);
+        *lowIndex = medians[(bootstrapCount * 25) / 1000];
+        *highIndex = medians[(bootstrapCount * 975) / 1000];
+    }
+}
+
+// NOTE(khvorov) Sorts the reservoir in place
+static RepeatStats repeatComputeStats(RepetitionTester* tester, i64 bootstrapCount) {
+    assert(bootstrapCount <= REPEAT_BOOTSTRAP_COUNT);
+
+    f64 freq = (f64)tester->freqPerSec;
+    RepeatStats stats = {
+        .minSec = (f64)tester->minDiffTime / freq,
+        .maxSec = (f64)tester->maxDiffTime / freq,
+        .meanSec = tester->diffTimeMean / freq,
+        .sampleCount = tester->sampleCount,
+    };
+    if (tester->diffCount > 1) {
+        stats.stddevSec = sqrt(tester->diffTimeM2 / (f64)(tester->diffCount - 1)) / freq;
+    }
+
+    i64 n = tester->sampleCount;
+    if (n > 0) {
+        u64* sorted = tester->samples;
+        qsort(sorted, n, sizeof(*sorted), u64Compare);
+        stats.medianSec = (f64)sorted[n / 2] / freq;
+
+        f64 q1 = (f64)sorted[n / 4];
+        f64 q3 = (f64)sorted[(3 * n) / 4];
+        f64 iqr = q3 - q1;
+        for (i64 ind = 0; ind < n; ind++) {
+            f64 sample = (f64)sorted[ind];
+            stats.outlierCount += sample < q1 - 1.5 * iqr || sample > q3 + 1.5 * iqr;
+        }
+
+        i64 lowIndex = 0;
+        i64 highIndex = 0;
+        bootstrapMedianCI(n, bootstrapCount, &tester->rng, tester->bootstrapCounts, tester->bootstrapMedians, &lowIndex, &highIndex);
+        stats.medianLowSec = (f64)sorted[lowIndex] / freq;
+        stats.medianHighSec = (f64)sorted[highIndex] / freq;
+    }
+    return stats;
+}
+
+// NOTE(khvorov) The median CI takes a bootstrap so it's only rechecked every eighth of the runs so far
+static bool
+repeatShouldStop(RepetitionTester* tester) {
+    RepeatStopPolicy* policy = &tester->policy;
+    if (tester->diffCount == 0) {
+        return false;
+    }
+
+    f64 elapsedSec = (f64)(__rdtsc() - tester->firstBegin) / (f64)tester->freqPerSec;
+    if (policy->capSec > 0 && elapsedSec >= policy->capSec) {
+        tester->capped = true;
+        return true;
+    }
+
+    bool result = false;
+    switch (policy->kind) {
+        case RepeatStopKind_MinUnchanged: result = tester->waited >= tester->toWait; break;
+        case RepeatStopKind_Iterations: result = (f64)tester->diffCount >= policy->value; break;
+        case RepeatStopKind_WallTime: result = elapsedSec >= policy->value; break;
+        case RepeatStopKind_MedianCI: {
+            if (tester->diffCount >= 16 && tester->diffCount >= tester->nextCICheck) {
+                tester->nextCICheck = tester->diffCount + max(8, tester->diffCount / 8);
+                RepeatStats stats = repeatComputeStats(tester, REPEAT_STOP_BOOTSTRAP_COUNT);
+                f64 widthPercent = (stats.medianHighSec - stats.medianLowSec) / stats.medianSec * 100.0;
+                result = widthPercent <= policy->value;
+            }
+        } break;
+        case RepeatStopKind_Count: assert(!"unreachable"); break;
+    }
+    return result;
+}
+
+static RepeatStats
+repeatPrint(RepetitionTester* tester) {
+    RepeatStats stats = repeatComputeStats(tester, REPEAT_BOOTSTRAP_COUNT);
+    f64 minSec = stats.minSec;
+    f64 maxSec = stats.maxSec;
+
+    f64 sizeGB = (f64)tester->expectedSize / (1024.0 * 1024.0 * 1024.0);
+    f64 minBand = sizeGB / minSec;
+    f64 maxBand = sizeGB / maxSec;
 
     f64 sizeKB = (f64)tester->expectedSize / (1024.0);
     f64 minKBPerPF = sizeKB / (f64)tester->minDiffPF;
     f64 maxKBPerPF = sizeKB / (f64)tester->maxDiffPF;
 
-    printf(
-        "repeat: %.*s min: %.2gs %.2ggb/s %lluPF %.2gKB/PF, max: %.2gs %.2ggb/s %lluPF %.2gKB/PF\n",
-        LIT(tester->name), minSec, minBand, tester->minDiffPF, minKBPerPF, maxSec, maxBand, tester->maxDiffPF, maxKBPerPF
-    );
+    printf(
+        "repeat: %.*s min: %.2gs %.2ggb/s %lluPF %.2gKB/PF, max: %.2gs %.2ggb/s %lluPF %.2gKB/PF",
+        LIT(tester->name), minSec, minBand, (unsigned long long)tester->minDiffPF, minKBPerPF, maxSec, maxBand, (unsigned long long)tester->maxDiffPF, maxKBPerPF
+    );
+#ifndef _WIN32
+    f64 runs = (f64)tester->diffCount;
+    printf(
+        ", majorPF/run: %.2g ctxsw/run: %.2g (involuntary %.2g)",
+        (f64)tester->majorPFSum / runs, (f64)tester->contextSwitchSum / runs, (f64)tester->involuntaryContextSwitchSum / runs
+    );
+#endif
+    printf("\n");
+    printf(
+        "    stop: %s %g cap: %gs%s\n",
+        globalRepeatStopKindNames[tester->policy.kind],
+        tester->policy.value,
+        tester->policy.capSec,
+        tester->capped ? " (capped)" : ""
+    );
+    printf(
+        "    runs: %llu mean: %.3gs %.3ggb/s sd: %.2g%% median: %.3gs %.3ggb/s 95%%ci: [%.3gs, %.3gs] [%.3ggb/s, %.3ggb/s] outliers: %lld/%lld\n",
+        (unsigned long long)tester->diffCount,
+        stats.meanSec,
+        sizeGB / stats.meanSec,
+        stats.stddevSec / stats.meanSec * 100.0,
+        stats.medianSec,
+        sizeGB / stats.medianSec,
+        stats.medianLowSec,
+        stats.medianHighSec,
+        sizeGB / stats.medianHighSec,
+        sizeGB / stats.medianLowSec,
+        (long long)stats.outlierCount,
+        (long long)stats.sampleCount
+    );
+    return stats;
+}
+
+#ifdef _WIN32
+static void writeEntireFile(char* path, void* content, i64 contentLen) {
+    HANDLE handle = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+    assert(handle != INVALID_HANDLE_VALUE);
+    DWORD bytesWritten = 0;
+    BOOL WriteFileResult = WriteFile(handle, content, (DWORD)contentLen, &bytesWritten, 0);
+    assert(WriteFileResult);
+    assert(bytesWritten == contentLen);
+    CloseHandle(handle);
+}
+
+typedef struct OpenedFile {
+    HANDLE handle;
+    i64 size;
+} OpenedFile;
+
+static bool tryOpenFile(char* path, OpenedFile* file) {
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    bool result = handle != INVALID_HANDLE_VALUE;
+    if (result) {
+        LARGE_INTEGER fileSize = {};
+        BOOL GetFileSizeExResult = GetFileSizeEx(handle, &fileSize);
+        assert(GetFileSizeExResult);
+        *file = (OpenedFile) {handle, fileSize.QuadPart};
+    }
+    return result;
+}
+
+static u8arr readAndCloseFile(Arena* arena, OpenedFile file) {
+    u8arr result = {.len = file.size};
+    result.ptr = arenaAllocArray(arena, u8, result.len);
+    DWORD bytesRead = 0;
+    BOOL ReadFileResult = ReadFile(file.handle, result.ptr, file.size, &bytesRead, 0);
+    assert(ReadFileResult);
+    assert(bytesRead == result.len);
+    CloseHandle(file.handle);
+    return result;
+}
+
+static void closeFile(OpenedFile file) {
+    CloseHandle(file.handle);
+}
+
+// NOTE(khvorov) No large pages here, the point is to pay for every first touch
+static void* allocFreshPages(i64 size) {
+    void* result = VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    assert(result);
+    return result;
+}
+
+static void freeFreshPages(void* ptr, i64 size) {
+    (void)size;
+    VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+// NOTE(khvorov) Large pages need SeLockMemoryPrivilege (main enables it) and whole large pages, returns 0 on failure
+static void* allocPages(i64 size, bool huge) {
+    void* result = 0;
+    if (huge) {
+        i64 largePage = GetLargePageMinimum();
+        if (largePage) {
+            size = (size + largePage - 1) / largePage * largePage;
+            result = VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        }
+    } else {
+        result = VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+    return result;
+}
+
+static void freePages(void* ptr, i64 size, bool huge) {
+    (void)size;
+    (void)huge;
+    VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+// NOTE(khvorov) MEM_LARGE_PAGES either backs the whole range or fails the allocation
+static i64 hugeBackedBytes(void* ptr, i64 size) {
+    (void)ptr;
+    return size;
+}
+
+static void printHugePageMode(void) {
+    printf("huge pages: MEM_LARGE_PAGES, %lldKB\n", (long long)(GetLargePageMinimum() / 1024));
+}
+
+// NOTE(khvorov) Generated code is written with the pages read-write and run with them read-execute, never both
+static void setPagesExecutable(void* ptr, i64 size, bool executable) {
+    DWORD oldProtect = 0;
+    BOOL VirtualProtectResult = VirtualProtect(ptr, size, executable ? PAGE_EXECUTE_READ : PAGE_READWRITE, &oldProtect);
+    assert(VirtualProtectResult);
+    if (executable) {
+        FlushInstructionCache(GetCurrentProcess(), ptr, size);
+    }
+}
+#else
+static void writeEntireFile(char* path, void* content, i64 contentLen) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert(fd != -1);
+    i64 bytesWritten = write(fd, content, contentLen);
+    assert(bytesWritten == contentLen);
+    close(fd);
+}
+
+typedef struct OpenedFile {
+    int fd;
+    i64 size;
+} OpenedFile;
+
+static bool tryOpenFile(char* path, OpenedFile* file) {
+    int fd = open(path, O_RDONLY);
+    bool result = fd != -1;
+    if (result) {
+        struct stat st = {};
+        int fstatResult = fstat(fd, &st);
+        assert(fstatResult == 0);
+        *file = (OpenedFile) {fd, st.st_size};
+    }
+    return result;
+}
+
+static u8arr readAndCloseFile(Arena* arena, OpenedFile file) {
+    u8arr result = {.len = file.size};
+    result.ptr = arenaAllocArray(arena, u8, result.len);
+    i64 bytesRead = 0;
+    while (bytesRead < result.len) {
+        ssize_t readResult = read(file.fd, result.ptr + bytesRead, result.len - bytesRead);
+        assert(readResult > 0);
+        bytesRead += readResult;
+    }
+    close(file.fd);
+    return result;
+}
+
+static void closeFile(OpenedFile file) {
+    close(file.fd);
+}
+
+// NOTE(khvorov) No MADV_HUGEPAGE here, the point is to pay for every first touch
+static void* allocFreshPages(i64 size) {
+    void* result = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    assert(result != MAP_FAILED);
+    return result;
+}
+
+static void freeFreshPages(void* ptr, i64 size) {
+    munmap(ptr, size);
+}
+
+#define HUGE_PAGE_SIZE (2 * Megabyte)
+
+// NOTE(khvorov) Huge means transparent huge pages on a 2MB aligned range, otherwise THP is explicitly turned off
+// so that the 4K numbers don't depend on the system default. Returns 0 on failure
+static void* allocPages(i64 size, bool huge) {
+    void* result = 0;
+    if (huge) {
+        size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        u8* mapped = mmap(0, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (mapped != MAP_FAILED) {
+            u8* aligned = (u8*)(((uintptr_t)mapped + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+            i64 head = aligned - mapped;
+            if (head > 0) {
+                munmap(mapped, head);
+            }
+            munmap(aligned + size, HUGE_PAGE_SIZE - head);
+            madvise(aligned, size, MADV_HUGEPAGE);
+            result = aligned;
+        }
+    } else {
+        void* mapped = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (mapped != MAP_FAILED) {
+            madvise(mapped, size, MADV_NOHUGEPAGE);
+            result = mapped;
+        }
+    }
+    return result;
+}
+
+static void freePages(void* ptr, i64 size, bool huge) {
+    if (huge) {
+        size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    }
+    munmap(ptr, size);
+}
+
+// NOTE(khvorov) MADV_HUGEPAGE is only a hint, this sums AnonHugePages over the mappings overlapping the range.
+// Only meaningful after the range has been touched
+static i64 hugeBackedBytes(void* ptr, i64 size) {
+    i64 result = 0;
+    FILE* file = fopen("/proc/self/smaps", "rb");
+    if (file) {
+        uintptr_t begin = (uintptr_t)ptr;
+        uintptr_t end = begin + size;
+        bool overlaps = false;
+        char line[512];
+        while (fgets(line, sizeof(line), file)) {
+            unsigned long long mapBegin = 0;
+            unsigned long long mapEnd = 0;
+            long long kb = 0;
+            if (sscanf(line, "%llx-%llx ", &mapBegin, &mapEnd) == 2) {
+                overlaps = mapBegin < end && mapEnd > begin;
+            } else if (overlaps && sscanf(line, "AnonHugePages: %lld kB", &kb) == 1) {
+                result += kb * 1024;
+            }
+        }
+        fclose(file);
+    }
+    result = min(result, size);
+    return result;
+}
+
+static void printHugePageMode(void) {
+    char mode[128] = "unknown";
+    FILE* file = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "rb");
+    if (file) {
+        if (!fgets(mode, sizeof(mode), file)) {
+            snprintf(mode, sizeof(mode), "unknown");
+        }
+        fclose(file);
+    }
+    mode[strcspn(mode, "\n")] = 0;
+    printf("transparent huge pages: %s\n", mode);
+}
+
+// NOTE(khvorov) Generated code is written with the pages read-write and run with them read-execute, never both
+static void setPagesExecutable(void* ptr, i64 size, bool executable) {
+    int mprotectResult = mprotect(ptr, size, executable ? PROT_READ | PROT_EXEC : PROT_READ | PROT_WRITE);
+    assert(mprotectResult == 0);
+}
+#endif
+
+typedef enum CpuFeature {
+    CpuFeature_AVX = 1 << 0,
+    CpuFeature_AVX2 = 1 << 1,
+    CpuFeature_AVX512F = 1 << 2,
+    CpuFeature_FMA = 1 << 3,
+} CpuFeature;
+
+static char* globalCpuFeatureNames[] = {"avx", "avx2", "avx512f", "fma"};
+
+// NOTE(khvorov) The CPUID bits alone aren't enough, the OS also has to save the ymm/zmm state (XCR0)
+static u32 getCpuFeatures(void) {
+    u32 result = 0;
+    u32 eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        bool osxsave = ecx & (1 << 27);
+        bool avx = ecx & (1 << 28);
+        bool fma = ecx & (1 << 12);
+        if (osxsave) {
+            u32 xcrLow = 0, xcrHigh = 0;
+            __asm__ volatile("xgetbv" : "=a"(xcrLow), "=d"(xcrHigh) : "c"(0));
+            bool ymmState = (xcrLow & 0x6) == 0x6;
+            bool zmmState = (xcrLow & 0xe6) == 0xe6;
+            if (avx && ymmState) {
+                result |= CpuFeature_AVX;
+            }
+            if (fma && ymmState) {
+                result |= CpuFeature_FMA;
+            }
+            if (__get_cpuid_max(0, 0) >= 7) {
+                __cpuid_count(7, 0, eax, ebx, ecx, edx);
+                if ((ebx & (1 << 5)) && ymmState) {
+                    result |= CpuFeature_AVX2;
+                }
+                if ((ebx & (1 << 16)) && zmmState) {
+                    result |= CpuFeature_AVX512F;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+static void printCpuFeatures(u32 features) {
+    for (i64 ind = 0; ind < arrayLen(globalCpuFeatureNames); ind++) {
+        if (features & (1 << ind)) {
+            printf(" %s", globalCpuFeatureNames[ind]);
+        }
+    }
+}
+
+static void flushCacheRange(void* ptr, i64 size) {
+    u8* bytes = (u8*)ptr;
+    for (i64 offset = 0; offset < size; offset += 64) {
+        _mm_clflush(bytes + offset);
+    }
+    _mm_mfence();
+}
+
+typedef enum BenchmarkMode {
+    BenchmarkMode_Warm,
+    BenchmarkMode_ColdCache,
+    BenchmarkMode_FreshMemory,
+    BenchmarkMode_Count,
+} BenchmarkMode;
+
+static char* globalBenchmarkModeNames[BenchmarkMode_Count] = {
+    [BenchmarkMode_Warm] = "warm",
+    [BenchmarkMode_ColdCache] = "cold",
+    [BenchmarkMode_FreshMemory] = "fresh",
+};
+
+typedef struct BenchmarkContext {
+    Arena* arena;
+    u64 rdtscFrequencyPerSecond;
+    char* inputPath;
+    u8* buf;
+    i64 bufSize;
+    i64 bufFilled;
+    RepeatStopPolicy stopPolicy;
+    u32 cpuFeatures;
+} BenchmarkContext;
+
+typedef struct Benchmark Benchmark;
+typedef void (*BenchmarkProc)(BenchmarkContext* ctx, Benchmark* bench);
+typedef void (*AsmKernel)(void* ptr, i64 bufSize);
+
+typedef enum BufferPrep {
+    BufferPrep_Zero,
+    BufferPrep_Ones,
+    BufferPrep_EveryN,
+    BufferPrep_Random,
+    BufferPrep_SystemRandom,
+} BufferPrep;
+
+// NOTE(khvorov) kernel is one timed repetition, setup/teardown run once around the whole tester.
+// expectedBytes of 0 means the whole shared buffer, setup can fill it in when it's only known at runtime.
+// touchedBytes is how much of the start of the shared buffer the kernel reads or writes, 0 means all of it.
+// usesInput ones read the --input file and are skipped when it isn't there
+struct Benchmark {
+    char* name;
+    BenchmarkProc setup;
+    BenchmarkProc teardown;
+    BenchmarkProc kernel;
+    i64 expectedBytes;
+    i64 param;
+    bool usesBuffer;
+    bool usesInput;
+    i64 touchedBytes;
+    AsmKernel asmKernel;
+    BufferPrep prep;
+    u32 requiredFeatures;
+};
+
+typedef struct BenchmarkResult {
+    char* name;
+    BenchmarkMode mode;
+    u64 runs;
+    i64 bytes;
+    u64 minPF;
+    u64 maxPF;
+    RepeatStopPolicy stopPolicy;
+    bool capped;
+    bool unsupported;
+    RepeatStats stats;
+} BenchmarkResult;
+
+static OpenedFile openFile(char* path) {
+    OpenedFile result = {};
+    bool opened = tryOpenFile(path, &result);
+    assert(opened);
+    return result;
+}
+
+static void benchReadFileSetup(BenchmarkContext* ctx, Benchmark* bench) {
+    OpenedFile file = openFile(ctx->inputPath);
+    bench->expectedBytes = file.size;
+    closeFile(file);
+}
+
+static void benchReadFile(BenchmarkContext* ctx, Benchmark* bench) {
+    OpenedFile file = openFile(ctx->inputPath);
+    u8arr content = readAndCloseFile(ctx->arena, file);
+    assert(bench->expectedBytes == content.len);
+}
+
+static void benchWriteLoop(BenchmarkContext* ctx, Benchmark* bench) {
+    (void)bench;
+    for (i64 ind = 0; ind < ctx->bufSize; ind++) {
+        ctx->buf[ind] = ind;
+    }
+}
+
+void BandwidthTest(void* ptr, i64 bufSize, i64 mask);
+void BandwidthTestBlocks(void* ptr, i64 outerCount, i64 blockSize);
+
+// NOTE(khvorov) BandwidthTestBlocks reads whole 128 byte unrolls so the working set is rounded down to that.
+// Returns the bytes one call with this outer count is going to read
+static i64 bandwidthBlocksPlan(i64 workingSet, i64 targetBytes, i64* outerCount, i64* blockSize) {
+    *blockSize = max(128, workingSet & ~(i64)127);
+    *outerCount = max(1, targetBytes / *blockSize);
+    return *outerCount * *blockSize;
+}
+
+static void benchBandwidth(BenchmarkContext* ctx, Benchmark* bench) {
+    BandwidthTest(ctx->buf, ctx->bufSize, bench->param - 1);
+}
+
+void MOVAllBytesAsm(void* ptr, i64 bufSize);
+void NOP3x1AllBytesAsm(void* ptr, i64 bufSize);
+void NOP1x3AllBytesAsm(void* ptr, i64 bufSize);
+void NOP1x9AllBytesAsm(void* ptr, i64 bufSize);
+void CMPAllBytesAsm(void* ptr, i64 bufSize);
+void DECAllBytesAsm(void* ptr, i64 bufSize);
+void ConditionalNopAsm(void* ptr, i64 bufSize);
+void MOVAllBytesAsmAlign64(void* ptr, i64 bufSize);
+void MOVAllBytesAsmAlign64Nop(void* ptr, i64 bufSize);
+void StoreManyTimesX1(void* ptr, i64 bufSize);
+void StoreManyTimesX2(void* ptr, i64 bufSize);
+void StoreManyTimesX3(void* ptr, i64 bufSize);
+void StoreManyTimesX4(void* ptr, i64 bufSize);
+void LoadManyTimesX1(void* ptr, i64 bufSize);
+void LoadManyTimesX2(void* ptr, i64 bufSize);
+void LoadManyTimesX3(void* ptr, i64 bufSize);
+void LoadManyTimesX4(void* ptr, i64 bufSize);
+void StoreManyTimesX2_64(void* ptr, i64 bufSize);
+void StoreManyTimesX2_128(void* ptr, i64 bufSize);
+void LoadManyTimesX2_64(void* ptr, i64 bufSize);
+void LoadManyTimesX2_128(void* ptr, i64 bufSize);
+void LoadManyTimesX2_256(void* ptr, i64 bufSize);
+void LoadManyTimesX2_512(void* ptr, i64 bufSize);
+
+// NOTE(khvorov) Asm kernels take the whole shared buffer, the setup lays out the bytes the kernel branches on
+// or reads (param is the N in every-Nth). Kernels can write into the buffer so it's prepared again every time
+static void benchAsmPrepare(BenchmarkContext* ctx, Benchmark* bench) {
+    u8* buf = ctx->buf;
+    i64 bufSize = ctx->bufSize;
+    switch (bench->prep) {
+        case BufferPrep_Zero: memset(buf, 0, bufSize); break;
+        case BufferPrep_Ones: memset(buf, 1, bufSize); break;
+        case BufferPrep_EveryN: {
+            memset(buf, 0, bufSize);
+            for (i64 ind = 0; ind < bufSize; ind += bench->param) {
+                buf[ind] = 1;
+            }
+        } break;
+        case BufferPrep_Random: {
+            Rng rng = createRng(bufSize);
+            for (i64 ind = 0; ind < bufSize; ind += 1) {
+                buf[ind] = randomU32(&rng);
+            }
+        } break;
+        case BufferPrep_SystemRandom: {
+#ifdef _WIN32
+            NTSTATUS genResult = BCryptGenRandom(0, buf, (ULONG)bufSize, BCRYPT_USE_SYSTEM_PREFERRED_RNG);
+            assert(genResult == 0);
+#else
+            for (i64 offset = 0; offset < bufSize;) {
+                ssize_t genResult = getrandom(buf + offset, bufSize - offset, 0);
+                assert(genResult > 0);
+                offset += genResult;
+            }
+#endif
+        } break;
+    }
+}
+
+static void benchAsm(BenchmarkContext* ctx, Benchmark* bench) {
+    bench->asmKernel(ctx->buf, ctx->bufSize);
+}
+
+// NOTE(khvorov) touched is 0 for kernels that walk the whole buffer. The Load/StoreManyTimes ones hit the same
+// address or two over and over and the NOP/CMP/DEC ones don't touch memory at all, one line is all cold needs to flush
+#define asmBenchmark(benchName, fn, bufferPrep, prepParam, features, touched) \
+    {.name = "Asm/" benchName, .setup = benchAsmPrepare, .kernel = benchAsm, .asmKernel = fn, .prep = bufferPrep, .param = prepParam, .usesBuffer = true, .touchedBytes = touched, .requiredFeatures = features}
+
+static Benchmark globalBenchmarks[] = {
+    {.name = "ReadFile", .setup = benchReadFileSetup, .kernel = benchReadFile, .usesInput = true},
+    {.name = "WriteLoop", .kernel = benchWriteLoop, .usesBuffer = true},
+    {.name = "BandwidthTest/64KB", .kernel = benchBandwidth, .param = 64 * Kilobyte, .usesBuffer = true, .touchedBytes = 64 * Kilobyte, .requiredFeatures = CpuFeature_AVX},
+    {.name = "BandwidthTest/1MB", .kernel = benchBandwidth, .param = 1 * Megabyte, .usesBuffer = true, .touchedBytes = 1 * Megabyte, .requiredFeatures = CpuFeature_AVX},
+    {.name = "BandwidthTest/2MB", .kernel = benchBandwidth, .param = 2 * Megabyte, .usesBuffer = true, .touchedBytes = 2 * Megabyte, .requiredFeatures = CpuFeature_AVX},
+    {.name = "BandwidthTest/4MB", .kernel = benchBandwidth, .param = 4 * Megabyte, .usesBuffer = true, .touchedBytes = 4 * Megabyte, .requiredFeatures = CpuFeature_AVX},
+    {.name = "BandwidthTest/8MB", .kernel = benchBandwidth, .param = 8 * Megabyte, .usesBuffer = true, .touchedBytes = 8 * Megabyte, .requiredFeatures = CpuFeature_AVX},
+    {.name = "BandwidthTest/16MB", .kernel = benchBandwidth, .param = 16 * Megabyte, .usesBuffer = true, .touchedBytes = 16 * Megabyte, .requiredFeatures = CpuFeature_AVX},
+    {.name = "BandwidthTest/32MB", .kernel = benchBandwidth, .param = 32 * Megabyte, .usesBuffer = true, .touchedBytes = 32 * Megabyte, .requiredFeatures = CpuFeature_AVX},
+    {.name = "BandwidthTest/64MB", .kernel = benchBandwidth, .param = 64 * Megabyte, .usesBuffer = true, .touchedBytes = 64 * Megabyte, .requiredFeatures = CpuFeature_AVX},
+    {.name = "BandwidthTest/128MB", .kernel = benchBandwidth, .param = 128 * Megabyte, .usesBuffer = true, .touchedBytes = 128 * Megabyte, .requiredFeatures = CpuFeature_AVX},
+    {.name = "BandwidthTest/1GB", .kernel = benchBandwidth, .param = 1 * Gigabyte, .usesBuffer = true, .touchedBytes = 1 * Gigabyte, .requiredFeatures = CpuFeature_AVX},
+
+    asmBenchmark("MOVAllBytesAsm", MOVAllBytesAsm, BufferPrep_Random, 0, 0, 0),
+    asmBenchmark("NOP3x1AllBytesAsm", NOP3x1AllBytesAsm, BufferPrep_Random, 0, 0, 64),
+    asmBenchmark("NOP1x3AllBytesAsm", NOP1x3AllBytesAsm, BufferPrep_Random, 0, 0, 64),
+    asmBenchmark("NOP1x9AllBytesAsm", NOP1x9AllBytesAsm, BufferPrep_Random, 0, 0, 64),
+    asmBenchmark("CMPAllBytesAsm", CMPAllBytesAsm, BufferPrep_Random, 0, 0, 64),
+    asmBenchmark("DECAllBytesAsm", DECAllBytesAsm, BufferPrep_Random, 0, 0, 64),
+    asmBenchmark("ConditionalNopAsm/NeverTaken", ConditionalNopAsm, BufferPrep_Zero, 0, 0, 0),
+    asmBenchmark("ConditionalNopAsm/AlwaysTaken", ConditionalNopAsm, BufferPrep_Ones, 0, 0, 0),
+    asmBenchmark("ConditionalNopAsm/Every2", ConditionalNopAsm, BufferPrep_EveryN, 2, 0, 0),
+    asmBenchmark("ConditionalNopAsm/Every3", ConditionalNopAsm, BufferPrep_EveryN, 3, 0, 0),
+    asmBenchmark("ConditionalNopAsm/Every4", ConditionalNopAsm, BufferPrep_EveryN, 4, 0, 0),
+    asmBenchmark("ConditionalNopAsm/Random", ConditionalNopAsm, BufferPrep_Random, 0, 0, 0),
+    asmBenchmark("ConditionalNopAsm/SystemRandom", ConditionalNopAsm, BufferPrep_SystemRandom, 0, 0, 0),
+    asmBenchmark("MOVAllBytesAsmAlign64", MOVAllBytesAsmAlign64, BufferPrep_Random, 0, 0, 0),
+    asmBenchmark("MOVAllBytesAsmAlign64Nop", MOVAllBytesAsmAlign64Nop, BufferPrep_Random, 0, 0, 0),
+    asmBenchmark("StoreManyTimesX1", StoreManyTimesX1, BufferPrep_Random, 0, 0, 128),
+    asmBenchmark("StoreManyTimesX2", StoreManyTimesX2, BufferPrep_Random, 0, 0, 128),
+    asmBenchmark("StoreManyTimesX3", StoreManyTimesX3, BufferPrep_Random, 0, 0, 128),
+    asmBenchmark("StoreManyTimesX4", StoreManyTimesX4, BufferPrep_Random, 0, 0, 128),
+    asmBenchmark("LoadManyTimesX1", LoadManyTimesX1, BufferPrep_Random, 0, 0, 128),
+    asmBenchmark("LoadManyTimesX2", LoadManyTimesX2, BufferPrep_Random, 0, 0, 128),
+    asmBenchmark("LoadManyTimesX3", LoadManyTimesX3, BufferPrep_Random, 0, 0, 128),
+    asmBenchmark("LoadManyTimesX4", LoadManyTimesX4, BufferPrep_Random, 0, 0, 128),
+    asmBenchmark("StoreManyTimesX2_64", StoreManyTimesX2_64, BufferPrep_Random, 0, 0, 128),
+    asmBenchmark("StoreManyTimesX2_128", StoreManyTimesX2_128, BufferPrep_Random, 0, 0, 128),
+    asmBenchmark("LoadManyTimesX2_64", LoadManyTimesX2_64, BufferPrep_Random, 0, 0, 128),
+    asmBenchmark("LoadManyTimesX2_128", LoadManyTimesX2_128, BufferPrep_Random, 0, 0, 128),
+    asmBenchmark("LoadManyTimesX2_256", LoadManyTimesX2_256, BufferPrep_Random, 0, CpuFeature_AVX, 128),
+    asmBenchmark("LoadManyTimesX2_512", LoadManyTimesX2_512, BufferPrep_Random, 0, CpuFeature_AVX512F, 128),
+};
+
+// NOTE(khvorov) The target of a run is the part of the shared buffer the kernel touches, or for benchmarks that don't
+// use it, the first expectedBytes of free arena space (where the kernel is going to allocate).
+// Cold flushes the target from cache before every run, fresh swaps it for memory that was never touched
+// (so buffer contents are zeros rather than the fill). Kernels that only read fresh memory get every page
+// mapped to the kernel's shared zero page, so they pay for the read faults but never for allocating and zeroing a page
+// The buffer is always BENCHMARK_BUFFER_SIZE of address space since kernels that take the whole buffer process that
+// many bytes per run, but only the prefix the selected benchmarks touch gets filled (memset, to fault the pages in
+// before timing). Benchmarks with a setup lay the buffer out themselves and don't need the fill
+#define BENCHMARK_BUFFER_SIZE (1 * Gigabyte)
+
+static void benchmarkEnsureBuffer(BenchmarkContext* ctx, i64 fillBytes) {
+    if (ctx->buf == 0) {
+        ctx->bufSize = BENCHMARK_BUFFER_SIZE;
+        ctx->buf = arenaAllocArray(ctx->arena, u8, ctx->bufSize);
+    }
+    fillBytes = min(fillBytes, ctx->bufSize);
+    if (fillBytes > ctx->bufFilled) {
+        memset(ctx->buf + ctx->bufFilled, 0xA5, fillBytes - ctx->bufFilled);
+        ctx->bufFilled = fillBytes;
+    }
+}
+
+static i64 benchmarkFillBytes(Benchmark* bench) {
+    i64 result = 0;
+    if (bench->usesBuffer && !bench->setup) {
+        result = bench->touchedBytes ? bench->touchedBytes : BENCHMARK_BUFFER_SIZE;
+    }
+    return result;
+}
+
+static RepetitionTester benchmarkBegin(BenchmarkContext* ctx, Benchmark* bench, BenchmarkMode mode) {
+    if (bench->setup) {
+        bench->setup(ctx, bench);
+    }
+    i64 bytes = bench->expectedBytes ? bench->expectedBytes : ctx->bufSize;
+    char* modeName = globalBenchmarkModeNames[mode];
+    i64 labelLen = strlen(bench->name) + strlen(modeName) + 3;
+    char* label = arenaAllocArray(ctx->arena, char, labelLen + 1);
+    snprintf(label, labelLen + 1, "%s [%s]", bench->name, modeName);
+    RepetitionTester tester = createRepetitionTester(ctx->arena, ctx->rdtscFrequencyPerSecond, bytes, (Str) {label, labelLen});
+    repeatSetStopPolicy(&tester, ctx->stopPolicy);
+    return tester;
+}
+
+static void benchmarkTimedRun(BenchmarkContext* ctx, Benchmark* bench, BenchmarkMode mode, RepetitionTester* tester) {
+    tempMemBlock(ctx->arena) {
+        i64 bytes = tester->expectedSize;
+        Arena* sharedArena = ctx->arena;
+        u8* sharedBuf = ctx->buf;
+        Arena freshArena = {};
+        switch (mode) {
+            case BenchmarkMode_Warm: break;
+            case BenchmarkMode_ColdCache: {
+                if (bench->usesBuffer) {
+                    flushCacheRange(ctx->buf, bench->touchedBytes ? min(bench->touchedBytes, ctx->bufSize) : ctx->bufSize);
+                } else {
+                    flushCacheRange(arenaFreeptr(ctx->arena), min(bytes, arenaFreesize(ctx->arena)));
+                }
+            } break;
+            case BenchmarkMode_FreshMemory: {
+                if (bench->usesBuffer) {
+                    ctx->buf = allocFreshPages(ctx->bufSize);
+                } else {
+                    freshArena = (Arena) {.base = allocFreshPages(bytes), .size = bytes};
+                    ctx->arena = &freshArena;
+                }
+            } break;
+            case BenchmarkMode_Count: assert(!"unreachable"); break;
+        }
+
+        repeatBeginTime(tester);
+        bench->kernel(ctx, bench);
+        repeatEndTime(tester);
+
+        if (mode == BenchmarkMode_FreshMemory) {
+            if (bench->usesBuffer) {
+                freeFreshPages(ctx->buf, ctx->bufSize);
+            } else {
+                freeFreshPages(freshArena.base, freshArena.size);
+            }
+            ctx->arena = sharedArena;
+            ctx->buf = sharedBuf;
+        }
+    }
+}
+
+static BenchmarkResult benchmarkEnd(BenchmarkContext* ctx, Benchmark* bench, BenchmarkMode mode, RepetitionTester* tester) {
+    if (bench->teardown) {
+        bench->teardown(ctx, bench);
+    }
+    BenchmarkResult result = {
+        .name = bench->name,
+        .mode = mode,
+        .runs = tester->diffCount,
+        .bytes = tester->expectedSize,
+        .minPF = tester->minDiffPF,
+        .maxPF = tester->maxDiffPF,
+        .stopPolicy = tester->policy,
+        .capped = tester->capped,
+    };
+    result.stats = repeatPrint(tester);
+    return result;
+}
+
+// NOTE(khvorov) Fresh pages are zeros, so a benchmark whose setup lays out the shared buffer (the asm ones, which branch
+// on or read that pattern) would be measuring a different workload there. Running the setup on the fresh pages
+// instead would touch all of them before the timed run and there'd be nothing fresh left
+static bool benchmarkSupportsMode(Benchmark* bench, BenchmarkMode mode) {
+    bool result = !(mode == BenchmarkMode_FreshMemory && bench->usesBuffer && bench->setup);
+    return result;
+}
+
+static BenchmarkResult runBenchmark(BenchmarkContext* ctx, Benchmark* bench, BenchmarkMode mode) {
+    RepetitionTester tester = benchmarkBegin(ctx, bench, mode);
+    while (!repeatShouldStop(&tester)) {
+        benchmarkTimedRun(ctx, bench, mode, &tester);
+    }
+    return benchmarkEnd(ctx, bench, mode, &tester);
+}
+
+// NOTE(khvorov) Paired A/B. Every pair runs both kernels back to back in a random order so that drift
+// lands on both sides alike. Ratios B/A go into their own reservoir. The significance is a two-sided sign test
+// (normal approximation, ties dropped) on how many pairs had B faster, next to a bootstrap CI of the median ratio
+
+typedef struct PairedStats {
+    i64 pairCount;
+    i64 bFasterCount;
+    i64 tieCount;
+    f64 ratioP05;
+    f64 ratioP25;
+    f64 ratioMedian;
+    f64 ratioP75;
+    f64 ratioP95;
+    f64 ratioMedianLow;
+    f64 ratioMedianHigh;
+    f64 signTestP;
+} PairedStats;
+
+static PairedStats computePairedStats(Arena* arena, f64* ratios, i64 ratioCount, i64 pairCount, i64 bFasterCount, i64 tieCount, Rng* rng) {
+    PairedStats stats = {.pairCount = pairCount, .bFasterCount = bFasterCount, .tieCount = tieCount, .signTestP = 1};
+    i64 n = ratioCount;
+    if (n > 0) {
+        qsort(ratios, n, sizeof(*ratios), f64Compare);
+        stats.ratioP05 = ratios[(n * 5) / 100];
+        stats.ratioP25 = ratios[n / 4];
+        stats.ratioMedian = ratios[n / 2];
+        stats.ratioP75 = ratios[(n * 3) / 4];
+        stats.ratioP95 = ratios[(n * 95) / 100];
+
+        tempMemBlock(arena) {
+            i32* counts = arenaAllocArray(arena, i32, n);
+            u64* medians = arenaAllocArray(arena, u64, REPEAT_BOOTSTRAP_COUNT);
+            i64 lowIndex = 0;
+            i64 highIndex = 0;
+            bootstrapMedianCI(n, REPEAT_BOOTSTRAP_COUNT, rng, counts, medians, &lowIndex, &highIndex);
+            stats.ratioMedianLow = ratios[lowIndex];
+            stats.ratioMedianHigh = ratios[highIndex];
+        }
+    }
+
+    f64 untied = (f64)(pairCount - tieCount);
+    if (untied > 0) {
+        f64 z = (fabs((f64)bFasterCount - untied / 2) - 0.5) / sqrt(untied / 4);
+        stats.signTestP = min(1.0, erfc(max(z, 0.0) / sqrt(2.0)));
+    }
+    return stats;
+}
+
+static PairedStats runPaired(BenchmarkContext* ctx, Benchmark* benchA, Benchmark* benchB, BenchmarkMode mode, BenchmarkResult* results) {
+    RepetitionTester testerA = benchmarkBegin(ctx, benchA, mode);
+    RepetitionTester testerB = benchmarkBegin(ctx, benchB, mode);
+    f64* ratios = arenaAllocArray(ctx->arena, f64, REPEAT_SAMPLE_COUNT);
+    i64 ratioCount = 0;
+    i64 pairCount = 0;
+    i64 bFasterCount = 0;
+    i64 tieCount = 0;
+    Rng rng = createRng(testerA.expectedSize ^ testerB.expectedSize);
+    for (;;) {
+        bool stopA = repeatShouldStop(&testerA);
+        bool stopB = repeatShouldStop(&testerB);
+        if ((stopA && stopB) || testerA.capped || testerB.capped) {
+            break;
+        }
+
+        if (randomU32Bound(&rng, 2) == 0) {
+            benchmarkTimedRun(ctx, benchA, mode, &testerA);
+            benchmarkTimedRun(ctx, benchB, mode, &testerB);
+        } else {
+            benchmarkTimedRun(ctx, benchB, mode, &testerB);
+            benchmarkTimedRun(ctx, benchA, mode, &testerA);
+        }
+
+        u64 timeA = testerA.lastDiffTime;
+        u64 timeB = testerB.lastDiffTime;
+        f64 ratio = (f64)timeB / (f64)max(timeA, 1);
+        pairCount += 1;
+        bFasterCount += timeB < timeA;
+        tieCount += timeB == timeA;
+        if (ratioCount < REPEAT_SAMPLE_COUNT) {
+            ratios[ratioCount++] = ratio;
+        } else {
+            u64 slot = randomU32Bound(&rng, (u32)min(pairCount, UINT32_MAX));
+            if (slot < REPEAT_SAMPLE_COUNT) {
+                ratios[slot] = ratio;
+            }
+        }
+    }
+
+    results[0] = benchmarkEnd(ctx, benchA, mode, &testerA);
+    results[1] = benchmarkEnd(ctx, benchB, mode, &testerB);
+
+    PairedStats stats = computePairedStats(ctx->arena, ratios, ratioCount, pairCount, bFasterCount, tieCount, &rng);
+    printf(
+        "pair: %s vs %s [%s] pairs: %lld B/A median: %.4g 95%%ci: [%.4g, %.4g] p5/p25/p75/p95: %.4g/%.4g/%.4g/%.4g B faster: %lld/%lld sign test p: %.3g\n",
+        benchA->name,
+        benchB->name,
+        globalBenchmarkModeNames[mode],
+        (long long)stats.pairCount,
+        stats.ratioMedian,
+        stats.ratioMedianLow,
+        stats.ratioMedianHigh,
+        stats.ratioP05,
+        stats.ratioP25,
+        stats.ratioP75,
+        stats.ratioP95,
+        (long long)stats.bFasterCount,
+        (long long)(stats.pairCount - stats.tieCount),
+        stats.signTestP
+    );
+    return stats;
+}
+
+// NOTE(khvorov) Bandwidth scaling. The calling thread is worker 0, the rest are started per thread count
+// and pinned one per logical core. Every run is released through a generation counter and ends when
+// the last worker checks in, so the tester times the slowest thread and the reported bytes are the total.
+// One buffer with a slice per thread is mapped for the whole sweep so that the DRAM sizes don't have to fit in the arena.
+// Pinning goes straight to pthread/Win32 affinity, cbuild.h's prb_allowExecutionOnCores would do but pawp doesn't
+// include cbuild.h
+
+#define BANDWIDTH_MAX_THREADS 64
+#define BANDWIDTH_BYTES_PER_THREAD (256 * Megabyte)
+
+typedef struct BandwidthScaling BandwidthScaling;
+
+typedef struct BandwidthWorker {
+    BandwidthScaling* scaling;
+    i64 index;
+    u8* buf;
+} BandwidthWorker;
+
+struct BandwidthScaling {
+    BandwidthWorker workers[BANDWIDTH_MAX_THREADS];
+    i64 mask;
+    u32 generation;
+    u32 doneCount;
+    bool quit;
+};
+
+typedef struct BandwidthScalingSize {
+    char* level;
+    i64 size;
+} BandwidthScalingSize;
+
+static void bandwidthWorkerRun(BandwidthWorker* worker) {
+    BandwidthScaling* scaling = worker->scaling;
+    u32 seenGeneration = 0;
+    for (;;) {
+        u32 generation = 0;
+        while ((generation = __atomic_load_n(&scaling->generation, __ATOMIC_ACQUIRE)) == seenGeneration) {
+            _mm_pause();
+        }
+        seenGeneration = generation;
+        if (scaling->quit) {
+            break;
+        }
+        BandwidthTest(worker->buf, BANDWIDTH_BYTES_PER_THREAD, scaling->mask);
+        __atomic_add_fetch(&scaling->doneCount, 1, __ATOMIC_RELEASE);
+    }
+}
+
+#ifdef _WIN32
+
+typedef HANDLE BandwidthThread;
+
+static DWORD WINAPI bandwidthWorkerProc(LPVOID arg) {
+    bandwidthWorkerRun((BandwidthWorker*)arg);
+    return 0;
+}
+
+static BandwidthThread startBandwidthWorker(BandwidthWorker* worker, i64 core) {
+    HANDLE thread = CreateThread(0, 0, bandwidthWorkerProc, worker, CREATE_SUSPENDED, 0);
+    assert(thread);
+    SetThreadAffinityMask(thread, 1ull << core);
+    ResumeThread(thread);
+    return thread;
+}
+
+static void joinBandwidthWorker(BandwidthThread thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+typedef DWORD_PTR ThreadAffinity;
+
+// NOTE(khvorov) Returns the affinity the thread had so it can be put back
+static ThreadAffinity pinCurrentThread(i64 core) {
+    ThreadAffinity previous = SetThreadAffinityMask(GetCurrentThread(), 1ull << core);
+    assert(previous);
+    return previous;
+}
+
+static void restoreCurrentThreadAffinity(ThreadAffinity affinity) {
+    SetThreadAffinityMask(GetCurrentThread(), affinity);
+}
+
+static i64 getCoreCount(void) {
+    SYSTEM_INFO info = {};
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+}
+
+#else
+
+typedef pthread_t BandwidthThread;
+
+static void* bandwidthWorkerProc(void* arg) {
+    bandwidthWorkerRun((BandwidthWorker*)arg);
+    return 0;
+}
+
+static BandwidthThread startBandwidthWorker(BandwidthWorker* worker, i64 core) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+    pthread_t thread = 0;
+    int createResult = pthread_create(&thread, &attr, bandwidthWorkerProc, worker);
+    assert(createResult == 0);
+    pthread_attr_destroy(&attr);
+    return thread;
+}
+
+static void joinBandwidthWorker(BandwidthThread thread) {
+    pthread_join(thread, 0);
+}
+
+typedef cpu_set_t ThreadAffinity;
+
+// NOTE(khvorov) Returns the affinity the thread had so it can be put back
+static ThreadAffinity pinCurrentThread(i64 core) {
+    ThreadAffinity previous;
+    CPU_ZERO(&previous);
+    pthread_getaffinity_np(pthread_self(), sizeof(previous), &previous);
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    return previous;
+}
+
+static void restoreCurrentThreadAffinity(ThreadAffinity affinity) {
+    pthread_setaffinity_np(pthread_self(), sizeof(affinity), &affinity);
+}
+
+static i64 getCoreCount(void) {
+    return sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+#endif
+
+static i64 runBandwidthScaling(BenchmarkContext* ctx, i64 maxThreads, BandwidthScalingSize* sizes, i64 sizeCount, BenchmarkResult* results) {
+    i64 resultCount = 0;
+    if (!(ctx->cpuFeatures & CpuFeature_AVX)) {
+        printf("skip: BandwidthScaling unsupported, needs avx\n");
+        return resultCount;
+    }
+    i64 coreCount = getCoreCount();
+    maxThreads = min(maxThreads, BANDWIDTH_MAX_THREADS);
+    i64 maxSize = 0;
+    for (i64 sizeIndex = 0; sizeIndex < sizeCount; sizeIndex++) {
+        maxSize = max(maxSize, sizes[sizeIndex].size);
+    }
+
+    i64 privateSize = maxSize * maxThreads;
+    u8* privateBuf = allocFreshPages(privateSize);
+    memset(privateBuf, 0xA5, privateSize);
+
+    BandwidthScaling* scaling = arenaAllocArray(ctx->arena, BandwidthScaling, 1);
+    ThreadAffinity previousAffinity = pinCurrentThread(0);
+    for (i64 threadCount = 1; threadCount <= maxThreads; threadCount++) {
+        *scaling = (BandwidthScaling) {};
+        BandwidthThread threads[BANDWIDTH_MAX_THREADS] = {};
+        for (i64 workerIndex = 0; workerIndex < threadCount; workerIndex++) {
+            scaling->workers[workerIndex] = (BandwidthWorker) {.scaling = scaling, .index = workerIndex};
+            if (workerIndex > 0) {
+                threads[workerIndex] = startBandwidthWorker(scaling->workers + workerIndex, workerIndex % coreCount);
+            }
+        }
+
+        for (i64 shared = 0; shared <= 1; shared++) {
+            for (i64 sizeIndex = 0; sizeIndex < sizeCount; sizeIndex++) {
+                BandwidthScalingSize size = sizes[sizeIndex];
+                scaling->mask = size.size - 1;
+                for (i64 workerIndex = 0; workerIndex < threadCount; workerIndex++) {
+                    scaling->workers[workerIndex].buf = shared ? privateBuf : privateBuf + workerIndex * maxSize;
+                }
+
+                i64 labelCap = 128;
+                char* label = arenaAllocArray(ctx->arena, char, labelCap);
+                i64 labelLen = snprintf(
+                    label,
+                    labelCap,
+                    "BandwidthScaling/%s/%s/%lldKB/%lldT",
+                    shared ? "shared" : "private",
+                    size.level,
+                    (long long)size.size / 1024,
+                    (long long)threadCount
+                );
+                i64 totalBytes = BANDWIDTH_BYTES_PER_THREAD * threadCount;
+                RepetitionTester tester_ = createRepetitionTester(ctx->arena, ctx->rdtscFrequencyPerSecond, totalBytes, (Str) {label, labelLen});
+                RepetitionTester* tester = &tester_;
+                repeatSetStopPolicy(tester, ctx->stopPolicy);
+                while (!repeatShouldStop(tester)) {
+                    __atomic_store_n(&scaling->doneCount, 0, __ATOMIC_RELAXED);
+                    repeatBeginTime(tester);
+                    __atomic_add_fetch(&scaling->generation, 1, __ATOMIC_RELEASE);
+                    BandwidthTest(scaling->workers[0].buf, BANDWIDTH_BYTES_PER_THREAD, scaling->mask);
+                    while (__atomic_load_n(&scaling->doneCount, __ATOMIC_ACQUIRE) < threadCount - 1) {
+                        _mm_pause();
+                    }
+                    repeatEndTime(tester);
+                }
+
+                BenchmarkResult result = {
+                    .name = label,
+                    .runs = tester->diffCount,
+                    .bytes = totalBytes,
+                    .minPF = tester->minDiffPF,
+                    .maxPF = tester->maxDiffPF,
+                    .stopPolicy = tester->policy,
+                    .capped = tester->capped,
+                };
+                result.stats = repeatPrint(tester);
+                results[resultCount++] = result;
+            }
+        }
+
+        scaling->quit = true;
+        __atomic_add_fetch(&scaling->generation, 1, __ATOMIC_RELEASE);
+        for (i64 workerIndex = 1; workerIndex < threadCount; workerIndex++) {
+            joinBandwidthWorker(threads[workerIndex]);
+        }
+    }
+    restoreCurrentThreadAffinity(previousAffinity);
+    freeFreshPages(privateBuf, privateSize);
+
+    return resultCount;
+}
+
+// NOTE(khvorov) Cache hierarchy. The measured sizes come from a read bandwidth sweep: consecutive sizes within
+// CACHE_PLATEAU_TOLERANCE of the mean of their plateau are one level, the last size before the drop is its capacity.
+// Single point plateaus are the transitions between levels and get dropped, neighbouring plateaus that end up
+// within the tolerance of each other (a noisy point split one level) are merged. The last plateau is DRAM.
+// The same levels are also read from CPUID (leaf 4 on Intel, 0x8000001D on AMD) and from the OS
+// (sysfs on Linux, GetLogicalProcessorInformation on Windows) to cross-check. Only data and unified caches are kept
+
+#define CACHE_MAX_LEVELS 4
+#define CACHE_PLATEAU_TOLERANCE 0.15
+#define CACHE_SWEEP_BYTES_PER_CALL (256 * Megabyte)
+#define CACHE_SWEEP_STEPS_PER_OCTAVE 4
+#define COARSE_SWEEP_STEPS_PER_OCTAVE 2
+
+typedef struct CacheLevelInfo {
+    i64 size;
+    i64 lineSize;
+    i64 ways;
+} CacheLevelInfo;
+
+typedef struct CacheHierarchy {
+    i64 measuredLevelCount;
+    i64 measuredSize[CACHE_MAX_LEVELS];
+    f64 measuredGBs[CACHE_MAX_LEVELS];
+    f64 dramGBs;
+    CacheLevelInfo cpuid[CACHE_MAX_LEVELS];
+    CacheLevelInfo os[CACHE_MAX_LEVELS];
+} CacheHierarchy;
+
+static CacheHierarchy globalCacheHierarchy;
+
+// NOTE(khvorov) level is 1-based. Prefers the measured size, then what the OS and CPUID say, 0 when nobody knows
+static i64 cacheLevelSize(CacheHierarchy* hierarchy, i64 level) {
+    i64 result = 0;
+    if (level >= 1 && level <= CACHE_MAX_LEVELS) {
+        i64 index = level - 1;
+        if (index < hierarchy->measuredLevelCount) {
+            result = hierarchy->measuredSize[index];
+        } else if (hierarchy->os[index].size) {
+            result = hierarchy->os[index].size;
+        } else {
+            result = hierarchy->cpuid[index].size;
+        }
+    }
+    return result;
+}
+
+static void readCpuidCacheInfo(CacheLevelInfo* levels) {
+    u32 eax = 0, ebx = 0, ecx = 0, edx = 0;
+    __cpuid(0, eax, ebx, ecx, edx);
+    u32 maxLeaf = eax;
+    bool amd = ebx == 0x68747541;
+    u32 leaf = 4;
+    if (amd) {
+        leaf = 0x8000001D;
+        if (__get_cpuid_max(0x80000000, 0) < leaf) {
+            return;
+        }
+    } else if (maxLeaf < leaf) {
+        return;
+    }
+
+    for (u32 subleaf = 0; subleaf < 16; subleaf++) {
+        __cpuid_count(leaf, subleaf, eax, ebx, ecx, edx);
+        u32 type = eax & 0x1f;
+        if (type == 0) {
+            break;
+        }
+        i64 level = (eax >> 5) & 0x7;
+        if (type == 2 || level < 1 || level > CACHE_MAX_LEVELS) {
+            continue;
+        }
+        CacheLevelInfo info = {
+            .lineSize = (ebx & 0xfff) + 1,
+            .ways = ((ebx >> 22) & 0x3ff) + 1,
+        };
+        i64 partitions = ((ebx >> 12) & 0x3ff) + 1;
+        i64 sets = (i64)ecx + 1;
+        info.size = info.ways * partitions * info.lineSize * sets;
+        levels[level - 1] = info;
+    }
+}
+
+#ifdef _WIN32
+
+static void readOsCacheInfo(Arena* arena, CacheLevelInfo* levels) {
+    tempMemBlock(arena) {
+        DWORD bufLen = 0;
+        GetLogicalProcessorInformation(0, &bufLen);
+        SYSTEM_LOGICAL_PROCESSOR_INFORMATION* infos = arenaAlloc(arena, bufLen);
+        if (GetLogicalProcessorInformation(infos, &bufLen)) {
+            i64 infoCount = bufLen / sizeof(*infos);
+            for (i64 ind = 0; ind < infoCount; ind++) {
+                SYSTEM_LOGICAL_PROCESSOR_INFORMATION* info = infos + ind;
+                if (info->Relationship == RelationCache) {
+                    CACHE_DESCRIPTOR* cache = &info->Cache;
+                    if ((cache->Type == CacheData || cache->Type == CacheUnified) && cache->Level >= 1 && cache->Level <= CACHE_MAX_LEVELS) {
+                        levels[cache->Level - 1] = (CacheLevelInfo) {.size = cache->Size, .lineSize = cache->LineSize, .ways = cache->Associativity};
+                    }
+                }
+            }
+        }
+    }
+}
+
+#else
+
+static i64 readSysfsNumber(char* dir, char* name) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE* file = fopen(path, "rb");
+    long long value = 0;
+    char suffix = 0;
+    if (file) {
+        int scanned = fscanf(file, "%lld%c", &value, &suffix);
+        fclose(file);
+        if (scanned == 2 && suffix == 'K') {
+            value *= 1024;
+        } else if (scanned == 2 && suffix == 'M') {
+            value *= 1024 * 1024;
+        }
+    }
+    return value;
+}
+
+static void readOsCacheInfo(Arena* arena, CacheLevelInfo* levels) {
+    (void)arena;
+    for (i64 index = 0; index < 16; index++) {
+        char dir[128];
+        snprintf(dir, sizeof(dir), "/sys/devices/system/cpu/cpu0/cache/index%lld", (long long)index);
+        char typePath[256];
+        snprintf(typePath, sizeof(typePath), "%s/type", dir);
+        FILE* typeFile = fopen(typePath, "rb");
+        if (!typeFile) {
+            break;
+        }
+        char type[32] = {};
+        int scanned = fscanf(typeFile, "%31s", type);
+        fclose(typeFile);
+        i64 level = readSysfsNumber(dir, "level");
+        if (scanned != 1 || strcmp(type, "Instruction") == 0 || level < 1 || level > CACHE_MAX_LEVELS) {
+            continue;
+        }
+        levels[level - 1] = (CacheLevelInfo) {
+            .size = readSysfsNumber(dir, "size"),
+            .lineSize = readSysfsNumber(dir, "coherency_line_size"),
+            .ways = readSysfsNumber(dir, "ways_of_associativity"),
+        };
+    }
+}
+
+#endif
+
+// NOTE(khvorov) One working set per known cache level for the bandwidth scaling sweep and one for DRAM. Half the level
+// rounded down to a power of two (BandwidthTest wraps with a mask) so it stays resident next to the stack and the
+// code. DRAM is 32 times the last level but no more than one call reads, anything past that would never be touched.
+// Levels come from the measured hierarchy when --cache ran, the OS/CPUID otherwise
+static i64 makeBandwidthScalingSizes(BenchmarkContext* ctx, CacheHierarchy* hierarchy, BandwidthScalingSize* sizes) {
+    if (!hierarchy->os[0].size && !hierarchy->cpuid[0].size) {
+        readCpuidCacheInfo(hierarchy->cpuid);
+        readOsCacheInfo(ctx->arena, hierarchy->os);
+    }
+
+    static char* levelNames[CACHE_MAX_LEVELS] = {"L1", "L2", "L3", "L4"};
+    i64 sizeCount = 0;
+    i64 lastSize = 0;
+    for (i64 level = 1; level <= CACHE_MAX_LEVELS; level++) {
+        i64 levelSize = cacheLevelSize(hierarchy, level);
+        if (levelSize < 2) {
+            continue;
+        }
+        i64 size = 1ll << (63 - __builtin_clzll(levelSize / 2));
+        if (size > lastSize) {
+            sizes[sizeCount++] = (BandwidthScalingSize) {levelNames[level - 1], size};
+            lastSize = size;
+        }
+    }
+    i64 dramSize = 128 * Megabyte;
+    while (dramSize < lastSize * 32 && dramSize < BANDWIDTH_BYTES_PER_THREAD) {
+        dramSize *= 2;
+    }
+    sizes[sizeCount++] = (BandwidthScalingSize) {"DRAM", dramSize};
+    return sizeCount;
+}
+
+// NOTE(khvorov) Geometric steps from 4KB to maxSize, rounded down to the 128 byte unroll
+static i64 makeCacheSweepSizes(i64* sizes, i64 sizeCap, i64 stepsPerOctave, i64 maxSize) {
+    i64 sizeCount = 0;
+    f64 factor = pow(2.0, 1.0 / (f64)max(stepsPerOctave, 1));
+    for (f64 size = 4 * Kilobyte; size <= (f64)maxSize && sizeCount < sizeCap; size *= factor) {
+        i64 rounded = (i64)size & ~(i64)127;
+        if (sizeCount == 0 || sizes[sizeCount - 1] != rounded) {
+            sizes[sizeCount++] = rounded;
+        }
+    }
+    return sizeCount;
+}
+
+// NOTE(khvorov) Comma separated, K/M/G suffixes are powers of 1024
+static i64 parseSizeList(char* list, i64* sizes, i64 sizeCap) {
+    i64 sizeCount = 0;
+    for (char* cur = list; *cur && sizeCount < sizeCap;) {
+        char* end = 0;
+        f64 value = strtod(cur, &end);
+        if (end == cur) {
+            return -1;
+        }
+        switch (*end) {
+            case 'k': case 'K': value *= Kilobyte; end++; break;
+            case 'm': case 'M': value *= Megabyte; end++; break;
+            case 'g': case 'G': value *= Gigabyte; end++; break;
+        }
+        if (*end == ',') {
+            end++;
+        } else if (*end) {
+            return -1;
+        }
+        sizes[sizeCount++] = (i64)value;
+        cur = end;
+    }
+    return sizeCount;
+}
+
+static i64 detectCacheHierarchy(BenchmarkContext* ctx, CacheHierarchy* hierarchy, i64* sizes, i64 sizeCount, BenchmarkResult* results) {
+    *hierarchy = (CacheHierarchy) {};
+    readCpuidCacheInfo(hierarchy->cpuid);
+    readOsCacheInfo(ctx->arena, hierarchy->os);
+
+    i64 resultCount = 0;
+    if (!(ctx->cpuFeatures & CpuFeature_AVX)) {
+        printf("skip: cache sweep unsupported, needs avx\n");
+    } else {
+        i64 maxSize = 0;
+        for (i64 sizeIndex = 0; sizeIndex < sizeCount; sizeIndex++) {
+            maxSize = max(maxSize, sizes[sizeIndex]);
+        }
+        benchmarkEnsureBuffer(ctx, maxSize);
+        i64* sweepSizes = arenaAllocArray(ctx->arena, i64, sizeCount);
+        f64* sweepGBs = arenaAllocArray(ctx->arena, f64, sizeCount);
+        i64 sweepCount = 0;
+        for (i64 sizeIndex = 0; sizeIndex < sizeCount; sizeIndex++) {
+            i64 outerCount = 0;
+            i64 blockSize = 0;
+            i64 bytes = bandwidthBlocksPlan(min(sizes[sizeIndex], ctx->bufSize), CACHE_SWEEP_BYTES_PER_CALL, &outerCount, &blockSize);
+
+            i64 labelCap = 64;
+            char* label = arenaAllocArray(ctx->arena, char, labelCap);
+            i64 labelLen = snprintf(label, labelCap, "CacheSweep/%.6gKB", (f64)blockSize / 1024.0);
+            RepetitionTester tester_ = createRepetitionTester(ctx->arena, ctx->rdtscFrequencyPerSecond, bytes, (Str) {label, labelLen});
+            RepetitionTester* tester = &tester_;
+            repeatSetStopPolicy(tester, ctx->stopPolicy);
+            while (!repeatShouldStop(tester)) {
+                repeatBeginTime(tester);
+                BandwidthTestBlocks(ctx->buf, outerCount, blockSize);
+                repeatEndTime(tester);
+            }
+            BenchmarkResult result = {
+                .name = label,
+                .runs = tester->diffCount,
+                .bytes = bytes,
+                .minPF = tester->minDiffPF,
+                .maxPF = tester->maxDiffPF,
+                .stopPolicy = tester->policy,
+                .capped = tester->capped,
+            };
+            result.stats = repeatPrint(tester);
+            results[resultCount++] = result;
+
+            sweepSizes[sweepCount] = blockSize;
+            sweepGBs[sweepCount] = (f64)bytes / (1024.0 * 1024.0 * 1024.0) / result.stats.minSec;
+            sweepCount += 1;
+        }
+
+        i64* plateauBegin = arenaAllocArray(ctx->arena, i64, sweepCount);
+        i64* plateauEnd = arenaAllocArray(ctx->arena, i64, sweepCount);
+        f64* plateauSum = arenaAllocArray(ctx->arena, f64, sweepCount);
+        i64 plateauCount = 0;
+        i64 curBegin = 0;
+        f64 curSum = 0;
+        for (i64 ind = 0; ind <= sweepCount; ind++) {
+            f64 curMean = curSum / (f64)max(ind - curBegin, 1);
+            bool dropped = ind == sweepCount || (ind > curBegin && sweepGBs[ind] < curMean * (1.0 - CACHE_PLATEAU_TOLERANCE));
+            if (dropped) {
+                bool transition = ind - curBegin == 1 && ind != sweepCount;
+                i64 prev = plateauCount - 1;
+                bool sameAsPrevious = prev >= 0 && plateauEnd[prev] == curBegin
+                    && curMean >= plateauSum[prev] / (f64)(plateauEnd[prev] - plateauBegin[prev]) * (1.0 - CACHE_PLATEAU_TOLERANCE);
+                if (sameAsPrevious) {
+                    plateauEnd[prev] = ind;
+                    plateauSum[prev] += curSum;
+                } else if (!transition) {
+                    plateauBegin[plateauCount] = curBegin;
+                    plateauEnd[plateauCount] = ind;
+                    plateauSum[plateauCount] = curSum;
+                    plateauCount += 1;
+                }
+                curBegin = ind;
+                curSum = 0;
+            }
+            if (ind < sweepCount) {
+                curSum += sweepGBs[ind];
+            }
+        }
+
+        for (i64 plateauIndex = 0; plateauIndex < plateauCount; plateauIndex++) {
+            f64 mean = plateauSum[plateauIndex] / (f64)(plateauEnd[plateauIndex] - plateauBegin[plateauIndex]);
+            if (plateauIndex == plateauCount - 1) {
+                hierarchy->dramGBs = mean;
+            } else if (hierarchy->measuredLevelCount < CACHE_MAX_LEVELS) {
+                hierarchy->measuredSize[hierarchy->measuredLevelCount] = sweepSizes[plateauEnd[plateauIndex] - 1];
+                hierarchy->measuredGBs[hierarchy->measuredLevelCount] = mean;
+                hierarchy->measuredLevelCount += 1;
+            }
+        }
+    }
+
+    printf("cache hierarchy (measured / os / cpuid):\n");
+    for (i64 index = 0; index < CACHE_MAX_LEVELS; index++) {
+        bool measured = index < hierarchy->measuredLevelCount;
+        CacheLevelInfo os = hierarchy->os[index];
+        CacheLevelInfo cpuid = hierarchy->cpuid[index];
+        if (!measured && !os.size && !cpuid.size) {
+            continue;
+        }
+        printf(
+            "    L%lld: %lldKB %.3ggb/s / %lldKB %lld-way %lldB lines / %lldKB %lld-way %lldB lines\n",
+            (long long)index + 1,
+            measured ? (long long)hierarchy->measuredSize[index] / 1024 : 0,
+            measured ? hierarchy->measuredGBs[index] : 0,
+            (long long)os.size / 1024,
+            (long long)os.ways,
+            (long long)os.lineSize,
+            (long long)cpuid.size / 1024,
+            (long long)cpuid.ways,
+            (long long)cpuid.lineSize
+        );
+    }
+    printf("    DRAM: %.3ggb/s\n", hierarchy->dramGBs);
+    return resultCount;
+}
+
+// NOTE(khvorov) Min over trials of one call, for the grids that are too big to run the repetition tester on every
+// cell. prep runs before every trial outside of the timed part and can be 0
+typedef void (*TimedCall)(void* data);
+
+static u64 timeMinTicks(TimedCall prep, TimedCall call, void* data, i64 trials) {
+    u64 result = UINT64_MAX;
+    for (i64 trial = 0; trial < trials; trial++) {
+        if (prep) {
+            prep(data);
+        }
+        u64 begin = __rdtsc();
+        call(data);
+        u64 end = __rdtsc();
+        result = min(result, end - begin);
+    }
+    return result;
+}
+
+typedef struct AsmCall {
+    AsmKernel kernel;
+    void* ptr;
+    i64 count;
+} AsmCall;
+
+static void timedAsmCall(void* data) {
+    AsmCall* call = (AsmCall*)data;
+    call->kernel(call->ptr, call->count);
+}
+
+// NOTE(khvorov) Load latency. The chain is a Sattolo permutation (a single cycle through every slot) so the walk
+// touches the whole buffer before repeating and the prefetchers can't guess the next address. At page granularity
+// every slot is on its own page and the line inside the page moves around so that the slots don't all land in one set.
+
+#define LATENCY_LOADS_PER_CALL (1 << 20)
+
+void* PointerChase(void* start, i64 count);
+
+typedef struct LatencyVariant {
+    char* name;
+    i64 granularity;
+    bool huge;
+} LatencyVariant;
+
+static LatencyVariant globalLatencyVariants[] = {
+    {"line", 64, false},
+    {"page", 4096, false},
+    {"line", 64, true},
+    {"page", 4096, true},
+};
+
+// NOTE(khvorov) Huge buffers are labelled by what backs them after they're touched, not by what was asked for
+static char* pagesLabel(void* buf, i64 size, bool huge) {
+    char* result = "4K";
+    if (huge) {
+        memset(buf, 0, size);
+        result = hugeBackedBytes(buf, size) == size ? "huge" : "thp-advised";
+    }
+    return result;
+}
+
+static i64 latencySlotOffset(i64 slot, i64 granularity) {
+    i64 linesPerSlot = granularity / 64;
+    i64 line = linesPerSlot > 1 ? (slot * 7) % linesPerSlot : 0;
+    return slot * granularity + line * 64;
+}
+
+static void* buildPointerChain(Arena* arena, u8* buf, i64 size, i64 granularity, Rng* rng) {
+    i64 slotCount = max(size / granularity, 1);
+    tempMemBlock(arena) {
+        i64* next = arenaAllocArray(arena, i64, slotCount);
+        for (i64 slot = 0; slot < slotCount; slot++) {
+            next[slot] = slot;
+        }
+        for (i64 slot = slotCount - 1; slot > 0; slot--) {
+            i64 other = randomU32Bound(rng, (u32)slot);
+            i64 temp = next[slot];
+            next[slot] = next[other];
+            next[other] = temp;
+        }
+        for (i64 slot = 0; slot < slotCount; slot++) {
+            *(u8**)(buf + latencySlotOffset(slot, granularity)) = buf + latencySlotOffset(next[slot], granularity);
+        }
+    }
+    return buf;
+}
+
+static i64 runLatencySweep(BenchmarkContext* ctx, CacheHierarchy* hierarchy, i64* sizes, i64 sizeCount, BenchmarkResult* results) {
+    if (!hierarchy->os[0].size && !hierarchy->cpuid[0].size) {
+        readCpuidCacheInfo(hierarchy->cpuid);
+        readOsCacheInfo(ctx->arena, hierarchy->os);
+    }
+
+    i64 maxSize = 0;
+    for (i64 sizeIndex = 0; sizeIndex < sizeCount; sizeIndex++) {
+        maxSize = max(maxSize, sizes[sizeIndex]);
+    }
+
+    printHugePageMode();
+    i64 resultCount = 0;
+    f64 freq = (f64)ctx->rdtscFrequencyPerSecond;
+    for (i64 variantIndex = 0; variantIndex < arrayLen(globalLatencyVariants); variantIndex++) {
+        LatencyVariant variant = globalLatencyVariants[variantIndex];
+        u8* buf = allocPages(maxSize, variant.huge);
+        if (!buf) {
+            printf("skip: Latency/%s/%s unsupported, could not allocate the pages\n", variant.name, variant.huge ? "huge" : "4K");
+            continue;
+        }
+        char* pages = pagesLabel(buf, maxSize, variant.huge);
+
+        f64* nsPerLoad = arenaAllocArray(ctx->arena, f64, sizeCount);
+        Rng rng = createRng(maxSize);
+        for (i64 sizeIndex = 0; sizeIndex < sizeCount; sizeIndex++) {
+            i64 size = max(sizes[sizeIndex], variant.granularity);
+            void* start = buildPointerChain(ctx->arena, buf, size, variant.granularity, &rng);
+
+            i64 labelCap = 64;
+            char* label = arenaAllocArray(ctx->arena, char, labelCap);
+            i64 labelLen = snprintf(label, labelCap, "Latency/%s/%s/%.6gKB", variant.name, pages, (f64)size / 1024.0);
+            i64 bytes = LATENCY_LOADS_PER_CALL * (i64)sizeof(void*);
+            RepetitionTester tester_ = createRepetitionTester(ctx->arena, ctx->rdtscFrequencyPerSecond, bytes, (Str) {label, labelLen});
+            RepetitionTester* tester = &tester_;
+            repeatSetStopPolicy(tester, ctx->stopPolicy);
+            while (!repeatShouldStop(tester)) {
+                repeatBeginTime(tester);
+                start = PointerChase(start, LATENCY_LOADS_PER_CALL);
+                repeatEndTime(tester);
+            }
+            BenchmarkResult result = {
+                .name = label,
+                .runs = tester->diffCount,
+                .bytes = bytes,
+                .minPF = tester->minDiffPF,
+                .maxPF = tester->maxDiffPF,
+                .stopPolicy = tester->policy,
+                .capped = tester->capped,
+            };
+            result.stats = repeatPrint(tester);
+            results[resultCount++] = result;
+            nsPerLoad[sizeIndex] = result.stats.minSec / LATENCY_LOADS_PER_CALL * 1e9;
+            printf("    %.3gns %.3g cycles per load\n", nsPerLoad[sizeIndex], result.stats.minSec * freq / LATENCY_LOADS_PER_CALL);
+        }
+        freePages(buf, maxSize, variant.huge);
+
+        // NOTE(khvorov) Per level it's the median over the sizes that fit in that level but not the one below
+        printf("latency %s/%s:", variant.name, pages);
+        i64 lowerSize = 0;
+        for (i64 level = 1; level <= CACHE_MAX_LEVELS + 1; level++) {
+            i64 levelSize = level <= CACHE_MAX_LEVELS ? cacheLevelSize(hierarchy, level) : INT64_MAX;
+            if (levelSize == 0) {
+                continue;
+            }
+            f64 levelNs[256] = {};
+            i64 levelCount = 0;
+            for (i64 sizeIndex = 0; sizeIndex < sizeCount && levelCount < arrayLen(levelNs); sizeIndex++) {
+                if (sizes[sizeIndex] > lowerSize && sizes[sizeIndex] <= levelSize) {
+                    levelNs[levelCount++] = nsPerLoad[sizeIndex];
+                }
+            }
+            if (levelCount > 0) {
+                qsort(levelNs, levelCount, sizeof(*levelNs), f64Compare);
+                f64 ns = levelNs[levelCount / 2];
+                if (level <= CACHE_MAX_LEVELS) {
+                    printf(" L%lld", (long long)level);
+                } else {
+                    printf(" DRAM");
+                }
+                printf(" %.3gns %.3gcyc", ns, ns * freq / 1e9);
+            }
+            lowerSize = levelSize;
+        }
+        printf("\n");
+    }
+    return resultCount;
+}
+
+// NOTE(khvorov) Write bandwidth over the same working sets as the cache sweep, one column per way of storing.
+// The read kernel is in there as the baseline. Everything stores zeros, GB/s is the min time
+
+typedef void (*BlockKernel)(void* ptr, i64 outerCount, i64 blockSize);
+
+void StoreBandwidthBlocks(void* ptr, i64 outerCount, i64 blockSize);
+void StoreBandwidthBlocksNT128(void* ptr, i64 outerCount, i64 blockSize);
+void StoreBandwidthBlocksNT(void* ptr, i64 outerCount, i64 blockSize);
+void StoreBandwidthRepStosb(void* ptr, i64 outerCount, i64 blockSize);
+
+typedef struct StoreVariant {
+    char* name;
+    BlockKernel kernel;
+    u32 requiredFeatures;
+} StoreVariant;
+
+static StoreVariant globalStoreVariants[] = {
+    {"read", BandwidthTestBlocks, CpuFeature_AVX},
+    {"vmovdqu", StoreBandwidthBlocks, CpuFeature_AVX},
+    {"rep stosb", StoreBandwidthRepStosb, 0},
+    {"movntdq", StoreBandwidthBlocksNT128, 0},
+    {"vmovntdq", StoreBandwidthBlocksNT, CpuFeature_AVX},
+};
+
+static i64 runStoreSweep(BenchmarkContext* ctx, i64* sizes, i64 sizeCount, BenchmarkResult* results) {
+    i64 maxSize = 0;
+    for (i64 sizeIndex = 0; sizeIndex < sizeCount; sizeIndex++) {
+        maxSize = max(maxSize, sizes[sizeIndex]);
+    }
+    benchmarkEnsureBuffer(ctx, maxSize + 64);
+    // NOTE(khvorov) Non-temporal stores fault on anything less than 16/32 byte aligned, line alignment is fair to all of them
+    u8* buf = (u8*)(((uintptr_t)ctx->buf + 63) & ~(uintptr_t)63);
+    i64 bufSize = ctx->bufSize - (buf - ctx->buf);
+    i64 variantCount = arrayLen(globalStoreVariants);
+    // NOTE(khvorov) Zero means the variant was skipped
+    f64* gbs = arenaAllocArray(ctx->arena, f64, sizeCount * variantCount);
+    memset(gbs, 0, sizeCount * variantCount * sizeof(*gbs));
+    i64 resultCount = 0;
+    for (i64 variantIndex = 0; variantIndex < variantCount; variantIndex++) {
+        StoreVariant variant = globalStoreVariants[variantIndex];
+        if (variant.requiredFeatures & ~ctx->cpuFeatures) {
+            printf("skip: StoreSweep/%s unsupported\n", variant.name);
+            continue;
+        }
+        for (i64 sizeIndex = 0; sizeIndex < sizeCount; sizeIndex++) {
+            i64 outerCount = 0;
+            i64 blockSize = 0;
+            i64 bytes = bandwidthBlocksPlan(min(sizes[sizeIndex], bufSize), CACHE_SWEEP_BYTES_PER_CALL, &outerCount, &blockSize);
+
+            i64 labelCap = 64;
+            char* label = arenaAllocArray(ctx->arena, char, labelCap);
+            i64 labelLen = snprintf(label, labelCap, "StoreSweep/%s/%.6gKB", variant.name, (f64)blockSize / 1024.0);
+            RepetitionTester tester_ = createRepetitionTester(ctx->arena, ctx->rdtscFrequencyPerSecond, bytes, (Str) {label, labelLen});
+            RepetitionTester* tester = &tester_;
+            repeatSetStopPolicy(tester, ctx->stopPolicy);
+            while (!repeatShouldStop(tester)) {
+                repeatBeginTime(tester);
+                variant.kernel(buf, outerCount, blockSize);
+                repeatEndTime(tester);
+            }
+            BenchmarkResult result = {
+                .name = label,
+                .runs = tester->diffCount,
+                .bytes = bytes,
+                .minPF = tester->minDiffPF,
+                .maxPF = tester->maxDiffPF,
+                .stopPolicy = tester->policy,
+                .capped = tester->capped,
+            };
+            result.stats = repeatPrint(tester);
+            results[resultCount++] = result;
+            gbs[sizeIndex * variantCount + variantIndex] = (f64)bytes / (1024.0 * 1024.0 * 1024.0) / result.stats.minSec;
+        }
+    }
+
+    printf("\nstore bandwidth GB/s\n%12s", "size");
+    for (i64 variantIndex = 0; variantIndex < variantCount; variantIndex++) {
+        printf(" %10s", globalStoreVariants[variantIndex].name);
+    }
+    printf("\n");
+    for (i64 sizeIndex = 0; sizeIndex < sizeCount; sizeIndex++) {
+        i64 outerCount = 0;
+        i64 blockSize = 0;
+        bandwidthBlocksPlan(min(sizes[sizeIndex], bufSize), CACHE_SWEEP_BYTES_PER_CALL, &outerCount, &blockSize);
+        printf("%10.6gKB", (f64)blockSize / 1024.0);
+        for (i64 variantIndex = 0; variantIndex < variantCount; variantIndex++) {
+            f64 value = gbs[sizeIndex * variantCount + variantIndex];
+            if (value > 0) {
+                printf(" %10.3g", value);
+            } else {
+                printf(" %10s", "-");
+            }
+        }
+        printf("\n");
+    }
+    return resultCount;
+}
+
+// NOTE(khvorov) K loads spaced S bytes apart, chased in a random cycle. Once S is a multiple of a level's
+// critical stride (size / ways) all K lines land in one set of that level and the walk falls out of it as soon as
+// K > ways, below that the lines spread over more sets. Huge pages when possible so that strides past 4K stay
+// physically contiguous and L2/L3 set conflicts show up too
+
+#define STRIDE_MAX_COUNT 64
+#define STRIDE_LOADS_PER_CALL (1 << 15)
+#define STRIDE_TRIALS 8
+
+static i64 globalStrideCounts[] = {1, 2, 4, 8, 9, 12, 13, 16, 17, 20, 24, 32, 33, 48, 64};
+
+void StoreLoadAlias(void* ptr, i64 count, i64 offset);
+
+typedef struct ChaseCall {
+    void* start;
+    i64 count;
+} ChaseCall;
+
+static void timedChase(void* data) {
+    ChaseCall* call = (ChaseCall*)data;
+    call->start = PointerChase(call->start, call->count);
+}
+
+typedef struct AliasCall {
+    void* ptr;
+    i64 count;
+    i64 offset;
+} AliasCall;
+
+static void timedStoreLoadAlias(void* data) {
+    AliasCall* call = (AliasCall*)data;
+    StoreLoadAlias(call->ptr, call->count, call->offset);
+}
+
+static void* buildStrideChain(u8* buf, i64 count, i64 stride, Rng* rng) {
+    i64 next[STRIDE_MAX_COUNT] = {};
+    assert(count <= STRIDE_MAX_COUNT);
+    for (i64 slot = 0; slot < count; slot++) {
+        next[slot] = slot;
+    }
+    for (i64 slot = count - 1; slot > 0; slot--) {
+        i64 other = randomU32Bound(rng, (u32)slot);
+        i64 temp = next[slot];
+        next[slot] = next[other];
+        next[other] = temp;
+    }
+    for (i64 slot = 0; slot < count; slot++) {
+        *(u8**)(buf + slot * stride) = buf + next[slot] * stride;
+    }
+    return buf;
+}
+
+static void runStrideSweep(BenchmarkContext* ctx) {
+    // NOTE(khvorov) Powers of two from a line to 4MB, and from 1K up each one again padded by a line,
+    // which is what padding a column or a per-thread buffer would do
+    i64 strides[64] = {};
+    i64 strideCount = 0;
+    for (i64 stride = 64; stride <= 4 * Megabyte; stride *= 2) {
+        strides[strideCount++] = stride;
+        if (stride >= Kilobyte) {
+            strides[strideCount++] = stride + 64;
+        }
+    }
+    i64 maxStride = strides[strideCount - 1];
+    i64 countCount = arrayLen(globalStrideCounts);
+
+    i64 bufSize = STRIDE_MAX_COUNT * maxStride;
+    bool huge = true;
+    u8* buf = allocPages(bufSize, huge);
+    if (!buf) {
+        huge = false;
+        buf = allocPages(bufSize, huge);
+    }
+    assert(buf);
+    printHugePageMode();
+    printf("stride sweep on %s pages, cycles per load\n%10s", pagesLabel(buf, bufSize, huge), "stride\\K");
+    for (i64 countIndex = 0; countIndex < countCount; countIndex++) {
+        printf(" %5lld", (long long)globalStrideCounts[countIndex]);
+    }
+    printf("\n");
+
+    f64* cycles = arenaAllocArray(ctx->arena, f64, strideCount * countCount);
+    Rng rng = createRng(bufSize);
+    for (i64 strideIndex = 0; strideIndex < strideCount; strideIndex++) {
+        i64 stride = strides[strideIndex];
+        if (stride % Kilobyte == 0) {
+            printf("%9lldK", (long long)(stride / Kilobyte));
+        } else if (stride < Kilobyte) {
+            printf("%10lld", (long long)stride);
+        } else {
+            printf("%8lldK+%lld", (long long)(stride / Kilobyte), (long long)(stride % Kilobyte));
+        }
+        for (i64 countIndex = 0; countIndex < countCount; countIndex++) {
+            ChaseCall call = {.start = buildStrideChain(buf, globalStrideCounts[countIndex], stride, &rng), .count = STRIDE_LOADS_PER_CALL};
+            u64 best = timeMinTicks(0, timedChase, &call, STRIDE_TRIALS);
+            f64 cyclesPerLoad = (f64)best / STRIDE_LOADS_PER_CALL;
+            cycles[strideIndex * countCount + countIndex] = cyclesPerLoad;
+            printf(" %5.3g", cyclesPerLoad);
+        }
+        printf("\n");
+    }
+    freePages(buf, bufSize, huge);
+
+    // NOTE(khvorov) A conflict step is a K that got 1.5x slower than the K before it while the padded stride didn't,
+    // steps the padded row has too are capacity or TLB, not sets. Doubling the stride halves the number of sets the
+    // loads can use so the step K halves with it until the stride reaches a level's critical stride, from there on it
+    // stays at ways + 1. So a step K that repeats on the next power of two is reported once at its first stride, and
+    // only the first such step per stride since the later ones are the same level missing harder
+    i64* steps = arenaAllocArray(ctx->arena, i64, strideCount * countCount);
+    i64* stepCounts = arenaAllocArray(ctx->arena, i64, strideCount);
+    memset(stepCounts, 0, strideCount * sizeof(*stepCounts));
+    printf("conflict steps (K where the power of two stride gets 1.5x slower and the padded one doesn't):\n");
+    for (i64 strideIndex = 0; strideIndex + 1 < strideCount; strideIndex++) {
+        if (strides[strideIndex] < Kilobyte || strides[strideIndex + 1] != strides[strideIndex] + 64) {
+            continue;
+        }
+        f64* row = cycles + strideIndex * countCount;
+        f64* padded = row + countCount;
+        printf("%9lldK", (long long)(strides[strideIndex] / Kilobyte));
+        for (i64 countIndex = 1; countIndex < countCount; countIndex++) {
+            bool rowStep = row[countIndex] > row[countIndex - 1] * 1.5;
+            bool paddedStep = padded[countIndex] > padded[countIndex - 1] * 1.5;
+            if (rowStep && !paddedStep) {
+                steps[strideIndex * countCount + stepCounts[strideIndex]++] = globalStrideCounts[countIndex];
+                printf(" %lld", (long long)globalStrideCounts[countIndex]);
+            }
+        }
+        printf("\n");
+    }
+    bool reported[STRIDE_MAX_COUNT + 1] = {};
+    for (i64 strideIndex = 0; strideIndex < strideCount; strideIndex++) {
+        i64 stride = strides[strideIndex];
+        if ((stride & (stride - 1)) != 0) {
+            continue;
+        }
+        i64 nextIndex = strideIndex + 1;
+        while (nextIndex < strideCount && strides[nextIndex] != stride * 2) {
+            nextIndex++;
+        }
+        if (nextIndex == strideCount) {
+            continue;
+        }
+        bool reportedHere = false;
+        for (i64 stepIndex = 0; stepIndex < stepCounts[strideIndex]; stepIndex++) {
+            i64 step = steps[strideIndex * countCount + stepIndex];
+            bool repeats = false;
+            for (i64 nextStepIndex = 0; nextStepIndex < stepCounts[nextIndex]; nextStepIndex++) {
+                repeats = repeats || steps[nextIndex * countCount + nextStepIndex] == step;
+            }
+            if (repeats && !reported[step]) {
+                reported[step] = true;
+                if (!reportedHere) {
+                    reportedHere = true;
+                    i64 waysBelow = 0;
+                    for (i64 countIndex = 0; countIndex < countCount && globalStrideCounts[countIndex] < step; countIndex++) {
+                        waysBelow = globalStrideCounts[countIndex];
+                    }
+                    printf("critical stride %lldK: ", (long long)(strides[strideIndex] / Kilobyte));
+                    if (waysBelow == step - 1) {
+                        printf("%lld ways", (long long)waysBelow);
+                    } else {
+                        printf("%lld..%lld ways", (long long)waysBelow, (long long)(step - 1));
+                    }
+                    printf(", pad strides that are multiples of it\n");
+                }
+            }
+        }
+    }
+
+    // NOTE(khvorov) 4K aliasing. A load whose address matches an in-flight store in the low 12 bits is held back as if
+    // it overlapped, so the offsets that are multiples of 4K come out slow even though they're different memory
+    i64 offsets[] = {0, 8, 64, 1024, 2048, 4032, 4088, 4096, 4104, 4160, 8192, 12288, 12352, 65536, 65600};
+    i64 aliasCount = 1 << 20;
+    u8* aliasBuf = arenaAllocArray(ctx->arena, u8, 128 * Kilobyte);
+    printf("store then load at an offset, cycles per iteration\n");
+    for (i64 offsetIndex = 0; offsetIndex < arrayLen(offsets); offsetIndex++) {
+        AliasCall call = {.ptr = aliasBuf, .count = aliasCount, .offset = offsets[offsetIndex]};
+        u64 best = timeMinTicks(0, timedStoreLoadAlias, &call, STRIDE_TRIALS);
+        f64 cyclesPerIteration = (f64)best / aliasCount;
+        printf("%10lld %5.3g%s\n", (long long)offsets[offsetIndex], cyclesPerIteration, offsets[offsetIndex] % 4096 == 0 ? " (same 4K offset)" : "");
+    }
+}
+
+// NOTE(khvorov) Branch patterns for ConditionalNopAsm, one byte per branch and the low bit is taken.
+// Periodic repeats a random sequence of the given length, so it takes history and not just a counter to predict.
+// Random is taken with a probability. Nested is an inner loop of length trips inside an outer one of outer trips,
+// every loop exit is a not-taken back edge. Bytes are branches so cycles/B in the report is cycles per branch
+
+#define BRANCH_PATTERN_BRANCHES (1 << 20)
+
+typedef enum BranchPatternKind {
+    BranchPattern_Periodic,
+    BranchPattern_Random,
+    BranchPattern_Nested,
+} BranchPatternKind;
+
+typedef struct BranchPattern {
+    BranchPatternKind kind;
+    i64 length;
+    f64 probability;
+    i64 outer;
+} BranchPattern;
+
+#define branchPeriodic(period) {.kind = BranchPattern_Periodic, .length = period}
+#define branchRandom(p) {.kind = BranchPattern_Random, .probability = p}
+#define branchNested(outerTrips, innerTrips) {.kind = BranchPattern_Nested, .length = innerTrips, .outer = outerTrips}
+
+static BranchPattern globalBranchPatterns[] = {
+    branchPeriodic(1),
+    branchPeriodic(2),
+    branchPeriodic(3),
+    branchPeriodic(4),
+    branchPeriodic(6),
+    branchPeriodic(8),
+    branchPeriodic(12),
+    branchPeriodic(16),
+    branchPeriodic(24),
+    branchPeriodic(32),
+    branchPeriodic(48),
+    branchPeriodic(64),
+    branchPeriodic(128),
+    branchPeriodic(256),
+    branchPeriodic(512),
+    branchPeriodic(1024),
+    branchPeriodic(2048),
+    branchPeriodic(4096),
+    branchPeriodic(16384),
+    branchRandom(0.01),
+    branchRandom(0.02),
+    branchRandom(0.05),
+    branchRandom(0.1),
+    branchRandom(0.2),
+    branchRandom(0.3),
+    branchRandom(0.5),
+    branchNested(4, 2),
+    branchNested(4, 4),
+    branchNested(4, 8),
+    branchNested(4, 16),
+    branchNested(4, 24),
+    branchNested(4, 32),
+    branchNested(4, 48),
+    branchNested(4, 64),
+};
+
+static bool branchPatternHasPeriod(u8* bits, i64 length, i64 period) {
+    bool result = true;
+    for (i64 ind = period; ind < length && result; ind++) {
+        result = bits[ind] == bits[ind - period];
+    }
+    return result;
+}
+
+static void fillBranchPattern(u8* buf, i64 count, BranchPattern pattern, Rng* rng) {
+    switch (pattern.kind) {
+        case BranchPattern_Periodic: {
+            // NOTE(khvorov) Redraw until the sequence doesn't repeat with a shorter period, 0101 is not period 4
+            bool shorter = true;
+            while (shorter) {
+                for (i64 ind = 0; ind < pattern.length; ind++) {
+                    buf[ind] = randomU32(rng) & 1;
+                }
+                shorter = false;
+                for (i64 period = 1; period < pattern.length && !shorter; period++) {
+                    shorter = pattern.length % period == 0 && branchPatternHasPeriod(buf, pattern.length, period);
+                }
+            }
+            for (i64 ind = pattern.length; ind < count; ind++) {
+                buf[ind] = buf[ind - pattern.length];
+            }
+        } break;
+        case BranchPattern_Random: {
+            for (i64 ind = 0; ind < count; ind++) {
+                buf[ind] = randomF3201(rng) < pattern.probability;
+            }
+        } break;
+        case BranchPattern_Nested: {
+            i64 ind = 0;
+            while (ind < count) {
+                for (i64 outer = 0; outer < pattern.outer && ind < count; outer++) {
+                    for (i64 inner = 0; inner < pattern.length && ind < count; inner++) {
+                        buf[ind++] = inner + 1 < pattern.length;
+                    }
+                    if (ind < count) {
+                        buf[ind++] = outer + 1 < pattern.outer;
+                    }
+                }
+            }
+        } break;
+    }
+}
+
+// NOTE(khvorov) Bits per branch of the taken/not-taken frequencies, for the periodic ones it's over one period
+// which is an upper bound, the sequence itself is fully determined by its history
+static f64 branchPatternEntropy(u8* buf, i64 count) {
+    i64 taken = 0;
+    for (i64 ind = 0; ind < count; ind++) {
+        taken += buf[ind];
+    }
+    f64 p = (f64)taken / (f64)count;
+    f64 result = 0;
+    if (p > 0 && p < 1) {
+        result = -p * log2(p) - (1 - p) * log2(1 - p);
+    }
+    return result;
+}
+
+static i64 runBranchPatterns(BenchmarkContext* ctx, BenchmarkResult* results) {
+    // NOTE(khvorov) The kernel reads 8 bytes at every branch so the buffer has 7 bytes of zeros past the end
+    u8* buf = arenaAllocArray(ctx->arena, u8, BRANCH_PATTERN_BRANCHES + 8);
+    f64 freq = (f64)ctx->rdtscFrequencyPerSecond;
+    Rng rng = createRng(BRANCH_PATTERN_BRANCHES);
+    i64 patternCount = arrayLen(globalBranchPatterns);
+    f64* cyclesPerBranch = arenaAllocArray(ctx->arena, f64, patternCount);
+    f64* entropy = arenaAllocArray(ctx->arena, f64, patternCount);
+    i64 resultCount = 0;
+    for (i64 patternIndex = 0; patternIndex < patternCount; patternIndex++) {
+        BranchPattern pattern = globalBranchPatterns[patternIndex];
+        fillBranchPattern(buf, BRANCH_PATTERN_BRANCHES, pattern, &rng);
+        entropy[patternIndex] = branchPatternEntropy(buf, pattern.kind == BranchPattern_Periodic ? pattern.length : BRANCH_PATTERN_BRANCHES);
+
+        i64 labelCap = 64;
+        char* label = arenaAllocArray(ctx->arena, char, labelCap);
+        i64 labelLen = 0;
+        switch (pattern.kind) {
+            case BranchPattern_Periodic: labelLen = snprintf(label, labelCap, "Branch/periodic/%lld", (long long)pattern.length); break;
+            case BranchPattern_Random: labelLen = snprintf(label, labelCap, "Branch/random/%g", pattern.probability); break;
+            case BranchPattern_Nested: labelLen = snprintf(label, labelCap, "Branch/nested/%lldx%lld", (long long)pattern.outer, (long long)pattern.length); break;
+        }
+        RepetitionTester tester_ = createRepetitionTester(ctx->arena, ctx->rdtscFrequencyPerSecond, BRANCH_PATTERN_BRANCHES, (Str) {label, labelLen});
+        RepetitionTester* tester = &tester_;
+        repeatSetStopPolicy(tester, ctx->stopPolicy);
+        while (!repeatShouldStop(tester)) {
+            repeatBeginTime(tester);
+            ConditionalNopAsm(buf, BRANCH_PATTERN_BRANCHES);
+            repeatEndTime(tester);
+        }
+        BenchmarkResult result = {
+            .name = label,
+            .runs = tester->diffCount,
+            .bytes = BRANCH_PATTERN_BRANCHES,
+            .minPF = tester->minDiffPF,
+            .maxPF = tester->maxDiffPF,
+            .stopPolicy = tester->policy,
+            .capped = tester->capped,
+        };
+        result.stats = repeatPrint(tester);
+        results[resultCount++] = result;
+        cyclesPerBranch[patternIndex] = result.stats.minSec * freq / BRANCH_PATTERN_BRANCHES;
+    }
+
+    // NOTE(khvorov) The cheapest pattern is as predicted as it gets. The mispredict cost comes from the random
+    // pattern closest to a coin flip, extra cycles over its miss rate min(p, 1 - p), and turns everyone's extra
+    // cycles into an estimated miss rate
+    f64 predicted = INFINITY;
+    f64 mispredictCycles = 0;
+    f64 worstMissRate = 0;
+    for (i64 patternIndex = 0; patternIndex < patternCount; patternIndex++) {
+        BranchPattern pattern = globalBranchPatterns[patternIndex];
+        predicted = min(predicted, cyclesPerBranch[patternIndex]);
+        if (pattern.kind == BranchPattern_Random) {
+            worstMissRate = max(worstMissRate, min(pattern.probability, 1 - pattern.probability));
+        }
+    }
+    for (i64 patternIndex = 0; patternIndex < patternCount; patternIndex++) {
+        BranchPattern pattern = globalBranchPatterns[patternIndex];
+        if (pattern.kind == BranchPattern_Random && min(pattern.probability, 1 - pattern.probability) == worstMissRate) {
+            mispredictCycles = (cyclesPerBranch[patternIndex] - predicted) / worstMissRate;
+        }
+    }
+
+    printf("\nbranch patterns, %.3g cycles per mispredict\n%-24s %8s %8s %8s\n", mispredictCycles, "pattern", "entropy", "cycles", "miss%");
+    i64 longestPredicted = 0;
+    for (i64 patternIndex = 0; patternIndex < patternCount; patternIndex++) {
+        BranchPattern pattern = globalBranchPatterns[patternIndex];
+        f64 missRate = mispredictCycles > 0 ? (cyclesPerBranch[patternIndex] - predicted) / mispredictCycles : 0;
+        printf("%-24s %8.3f %8.3g %8.2f\n", results[patternIndex].name + strlen("Branch/"), entropy[patternIndex], cyclesPerBranch[patternIndex], missRate * 100);
+        // NOTE(khvorov) A branch whose pattern repeats within the longest predicted period is fine as a branch
+        if (pattern.kind == BranchPattern_Periodic && missRate < 0.05) {
+            longestPredicted = max(longestPredicted, pattern.length);
+        }
+    }
+    printf("periodic patterns predicted up to period %lld\n", (long long)longestPredicted);
+    return resultCount;
 }
 
-static void writeEntireFile(char* path, void* content, i64 contentLen) {
-    HANDLE handle = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
-    assert(handle != INVALID_HANDLE_VALUE);
-    DWORD bytesWritten = 0;
-    BOOL WriteFileResult = WriteFile(handle, content, (DWORD)contentLen, &bytesWritten, 0);
-    assert(WriteFileResult);
-    assert(bytesWritten == contentLen);
-    CloseHandle(handle);
+// NOTE(khvorov) The MOVAllBytesAsm loop generated at runtime with its first instruction at every offset 0..63 past a
+// 64 byte boundary, and with long nops inside the loop to make it bigger. Replaces editing the %rep in
+// MOVAllBytesAsmAlign64Nop (which is offset 59 of the smallest size). Shows where the loop crossing a 32 byte
+// decode window or a 64 byte line costs something
+
+#define CODE_ALIGN_ITERATIONS (1 << 20)
+#define CODE_ALIGN_TRIALS 8
+
+static i64 globalCodeAlignFillers[] = {0, 8, 21, 40, 100};
+
+typedef struct CodeBuilder {
+    u8* base;
+    i64 len;
+    i64 cap;
+} CodeBuilder;
+
+static void codeBytes(CodeBuilder* code, u8* bytes, i64 count) {
+    assert(code->len + count <= code->cap);
+    memcpy(code->base + code->len, bytes, count);
+    code->len += count;
 }
 
-typedef struct OpenedFile {
-    HANDLE handle;
-    i64 size;
-} OpenedFile;
+// NOTE(khvorov) The recommended multi-byte nops, so that filler is one instruction per up to 9 bytes
+static void codeNops(CodeBuilder* code, i64 count) {
+    static u8 nops[9][9] = {
+        {0x90},
+        {0x66, 0x90},
+        {0x0f, 0x1f, 0x00},
+        {0x0f, 0x1f, 0x40, 0x00},
+        {0x0f, 0x1f, 0x44, 0x00, 0x00},
+        {0x66, 0x0f, 0x1f, 0x44, 0x00, 0x00},
+        {0x0f, 0x1f, 0x80, 0x00, 0x00, 0x00, 0x00},
+        {0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00},
+        {0x66, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00},
+    };
+    while (count > 0) {
+        i64 size = min(count, 9);
+        codeBytes(code, nops[size - 1], size);
+        count -= size;
+    }
+}
 
-static OpenedFile openFile(char* path) {
-    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
-    assert(handle != INVALID_HANDLE_VALUE);
-    LARGE_INTEGER fileSize = {};
-    BOOL GetFileSizeExResult = GetFileSizeEx(handle, &fileSize);
-    assert(GetFileSizeExResult);
-    OpenedFile result = {handle, fileSize.QuadPart};
+static void codeJumpIfNotZero(CodeBuilder* code, i64 target) {
+    i64 rel8 = target - (code->len + 2);
+    if (rel8 >= -128) {
+        u8 jnz[] = {0x75, (u8)rel8};
+        codeBytes(code, jnz, sizeof(jnz));
+    } else {
+        i32 rel32 = (i32)(target - (code->len + 6));
+        u8 jnz[] = {0x0f, 0x85};
+        codeBytes(code, jnz, sizeof(jnz));
+        codeBytes(code, (u8*)&rel32, sizeof(rel32));
+    }
+}
+
+// NOTE(khvorov) Same as MOVAllBytesAsm. Returns the loop's size in bytes
+static i64 emitMovAllBytesLoop(CodeBuilder* code, i64 loopOffset, i64 filler) {
+#ifdef _WIN32
+    u8 mov[] = {0x88, 0x04, 0x01}; // mov [rcx + rax], al
+    u8 cmp[] = {0x48, 0x39, 0xd0}; // cmp rax, rdx
+#else
+    u8 mov[] = {0x88, 0x04, 0x07}; // mov [rdi + rax], al
+    u8 cmp[] = {0x48, 0x39, 0xf0}; // cmp rax, rsi
+#endif
+    u8 xor[] = {0x31, 0xc0}; // xor eax, eax
+    u8 inc[] = {0x48, 0xff, 0xc0}; // inc rax
+    u8 ret[] = {0xc3};
+
+    codeBytes(code, xor, sizeof(xor));
+    codeNops(code, 64 + loopOffset - code->len);
+    i64 loopBegin = code->len;
+    codeBytes(code, mov, sizeof(mov));
+    codeNops(code, filler);
+    codeBytes(code, inc, sizeof(inc));
+    codeBytes(code, cmp, sizeof(cmp));
+    codeJumpIfNotZero(code, loopBegin);
+    i64 loopSize = code->len - loopBegin;
+    codeBytes(code, ret, sizeof(ret));
+    return loopSize;
+}
+
+static void runCodeAlignSweep(BenchmarkContext* ctx) {
+    i64 codeSize = 4096;
+    u8* codePages = allocFreshPages(codeSize);
+    u8* buf = arenaAllocArray(ctx->arena, u8, CODE_ALIGN_ITERATIONS);
+    i64 fillerCount = arrayLen(globalCodeAlignFillers);
+    f64* cycles = arenaAllocArray(ctx->arena, f64, 64 * fillerCount);
+    i64* loopSizes = arenaAllocArray(ctx->arena, i64, fillerCount);
+
+    for (i64 loopOffset = 0; loopOffset < 64; loopOffset++) {
+        for (i64 fillerIndex = 0; fillerIndex < fillerCount; fillerIndex++) {
+            setPagesExecutable(codePages, codeSize, false);
+            CodeBuilder code = {.base = codePages, .cap = codeSize};
+            loopSizes[fillerIndex] = emitMovAllBytesLoop(&code, loopOffset, globalCodeAlignFillers[fillerIndex]);
+            setPagesExecutable(codePages, codeSize, true);
+
+            AsmCall call = {.kernel = (AsmKernel)(void*)codePages, .ptr = buf, .count = CODE_ALIGN_ITERATIONS};
+            u64 best = timeMinTicks(0, timedAsmCall, &call, CODE_ALIGN_TRIALS);
+            cycles[loopOffset * fillerCount + fillerIndex] = (f64)best / CODE_ALIGN_ITERATIONS;
+        }
+    }
+    freeFreshPages(codePages, codeSize);
+
+    // NOTE(khvorov) * is a loop that crosses a 32 byte window, ** one that crosses a 64 byte line too
+    printf("code alignment, cycles per iteration by loop offset and loop size\n%6s", "offset");
+    for (i64 fillerIndex = 0; fillerIndex < fillerCount; fillerIndex++) {
+        printf(" %8lldB", (long long)loopSizes[fillerIndex]);
+    }
+    printf("\n");
+    for (i64 loopOffset = 0; loopOffset < 64; loopOffset++) {
+        printf("%6lld", (long long)loopOffset);
+        for (i64 fillerIndex = 0; fillerIndex < fillerCount; fillerIndex++) {
+            i64 loopEnd = loopOffset + loopSizes[fillerIndex] - 1;
+            char* mark = loopEnd / 64 != loopOffset / 64 ? "**" : loopEnd / 32 != loopOffset / 32 ? "*" : "";
+            printf(" %7.3g%-2s", cycles[loopOffset * fillerCount + fillerIndex], mark);
+        }
+        printf("\n");
+    }
+
+    // NOTE(khvorov) Per size, the best and worst offsets and the mean with and without crossing a 32 byte window
+    for (i64 fillerIndex = 0; fillerIndex < fillerCount; fillerIndex++) {
+        i64 bestOffset = 0;
+        i64 worstOffset = 0;
+        f64 crossingSum = 0;
+        i64 crossingCount = 0;
+        f64 insideSum = 0;
+        i64 insideCount = 0;
+        for (i64 loopOffset = 0; loopOffset < 64; loopOffset++) {
+            f64 value = cycles[loopOffset * fillerCount + fillerIndex];
+            bestOffset = value < cycles[bestOffset * fillerCount + fillerIndex] ? loopOffset : bestOffset;
+            worstOffset = value > cycles[worstOffset * fillerCount + fillerIndex] ? loopOffset : worstOffset;
+            i64 loopEnd = loopOffset + loopSizes[fillerIndex] - 1;
+            if (loopEnd / 32 != loopOffset / 32) {
+                crossingSum += value;
+                crossingCount += 1;
+            } else {
+                insideSum += value;
+                insideCount += 1;
+            }
+        }
+        printf(
+            "%lldB loop: best offset %lld %.3g, worst offset %lld %.3g",
+            (long long)loopSizes[fillerIndex],
+            (long long)bestOffset,
+            cycles[bestOffset * fillerCount + fillerIndex],
+            (long long)worstOffset,
+            cycles[worstOffset * fillerCount + fillerIndex]
+        );
+        if (insideCount > 0 && crossingCount > 0) {
+            printf(", mean inside a 32B window %.3g, crossing %.3g", insideSum / insideCount, crossingSum / crossingCount);
+        }
+        printf("\n");
+    }
+}
+
+// NOTE(khvorov) Port throughput kernels generated from a template instead of copying LoadManyTimesX1..4 by hand.
+// A template is an instruction and the widths it comes in, a kernel is that times count per iteration, either
+// independent (destinations rotate over registers, sources are never written) or chained (every one reads the
+// previous result, so it's latency). Encoded as REX for general purpose registers, VEX up to 256 and EVEX for 512.
+// Everything runs on a small page laid out as
+//     base - 64: 1.0f x 16, base: 1.0 x 8, base + 64: base + 64
+// so registers start as normal floats (no denormal assists) and mov rax, [rax] chases itself.
+// vfmadd231ps accumulates into its destination so independent there is one chain per register.
+
+#define PORT_ITERATIONS (1 << 16)
+#define PORT_TRIALS 8
+
+static void resetPortPage(void* data) {
+    u8* base = (u8*)((AsmCall*)data)->ptr;
+    for (i64 ind = 0; ind < 16; ind++) {
+        ((f32*)(base - 64))[ind] = 1.0f;
+    }
+    for (i64 ind = 0; ind < 8; ind++) {
+        ((f64*)base)[ind] = 1.0;
+    }
+    *(u8**)(base + 64) = base + 64;
+}
+
+// NOTE(khvorov) xmm6-15 are callee-saved on Windows, the kernels don't bother saving them
+#ifdef _WIN32
+#define PORT_VECTOR_REGS 6
+#define PORT_BASE_REG 1
+#define PORT_COUNT_REG 2
+#else
+#define PORT_VECTOR_REGS 16
+#define PORT_BASE_REG 7
+#define PORT_COUNT_REG 6
+#endif
+
+typedef enum PortForm {
+    PortForm_GprOp,
+    PortForm_GprLoad,
+    PortForm_GprStore,
+    PortForm_VecLoad,
+    PortForm_VecStore,
+    PortForm_VecBinary,
+    PortForm_VecUnary,
+} PortForm;
+
+typedef enum PortWidth {
+    PortWidth_64 = 1 << 0,
+    PortWidth_128 = 1 << 1,
+    PortWidth_256 = 1 << 2,
+    PortWidth_512 = 1 << 3,
+} PortWidth;
+
+// NOTE(khvorov) map is 0 for one byte opcodes, 1 for 0F, 2 for 0F38. pp is the VEX/EVEX implied prefix
+// (0 none, 1 66, 2 F3, 3 F2). features256 is on top of features at 256 and up, AVX2 for the integer ones
+typedef struct PortTemplate {
+    char* mnemonic;
+    PortForm form;
+    u8 map;
+    u8 pp;
+    u8 opcode;
+    bool w;
+    u32 widths;
+    u32 features;
+    u32 features256;
+    bool doubles;
+} PortTemplate;
+
+static PortTemplate globalPortTemplates[] = {
+    {"add", PortForm_GprOp, 0, 0, 0x03, true, PortWidth_64, 0, 0, false},
+    {"imul", PortForm_GprOp, 1, 0, 0xaf, true, PortWidth_64, 0, 0, false},
+    {"mov load", PortForm_GprLoad, 0, 0, 0x8b, true, PortWidth_64, 0, 0, false},
+    {"mov store", PortForm_GprStore, 0, 0, 0x89, true, PortWidth_64, 0, 0, false},
+    {"vmovdqu load", PortForm_VecLoad, 1, 2, 0x6f, true, PortWidth_128 | PortWidth_256 | PortWidth_512, CpuFeature_AVX, 0, false},
+    {"vmovdqu store", PortForm_VecStore, 1, 2, 0x7f, true, PortWidth_128 | PortWidth_256 | PortWidth_512, CpuFeature_AVX, 0, false},
+    {"vpaddd", PortForm_VecBinary, 1, 1, 0xfe, false, PortWidth_128 | PortWidth_256 | PortWidth_512, CpuFeature_AVX, CpuFeature_AVX2, false},
+    {"vpshufb", PortForm_VecBinary, 2, 1, 0x00, false, PortWidth_128 | PortWidth_256, CpuFeature_AVX, CpuFeature_AVX2, false},
+    {"vpermd", PortForm_VecBinary, 2, 1, 0x36, false, PortWidth_256 | PortWidth_512, CpuFeature_AVX2, 0, false},
+    {"vaddps", PortForm_VecBinary, 1, 0, 0x58, false, PortWidth_128 | PortWidth_256 | PortWidth_512, CpuFeature_AVX, 0, false},
+    {"vmulps", PortForm_VecBinary, 1, 0, 0x59, false, PortWidth_128 | PortWidth_256 | PortWidth_512, CpuFeature_AVX, 0, false},
+    {"vfmadd231ps", PortForm_VecBinary, 2, 1, 0xb8, false, PortWidth_128 | PortWidth_256 | PortWidth_512, CpuFeature_FMA, 0, false},
+    {"vdivps", PortForm_VecBinary, 1, 0, 0x5e, false, PortWidth_128 | PortWidth_256 | PortWidth_512, CpuFeature_AVX, 0, false},
+    {"vdivpd", PortForm_VecBinary, 1, 1, 0x5e, true, PortWidth_128 | PortWidth_256 | PortWidth_512, CpuFeature_AVX, 0, true},
+    {"vsqrtps", PortForm_VecUnary, 1, 0, 0x51, false, PortWidth_128 | PortWidth_256 | PortWidth_512, CpuFeature_AVX, 0, false},
+    {"vsqrtpd", PortForm_VecUnary, 1, 1, 0x51, true, PortWidth_128 | PortWidth_256 | PortWidth_512, CpuFeature_AVX, 0, true},
+};
+
+static i64 globalPortCounts[] = {1, 2, 4, 8};
+
+static void codeByte(CodeBuilder* code, u8 byte) {
+    codeBytes(code, &byte, 1);
+}
+
+// NOTE(khvorov) Register direct, or [rm + disp8]. rm can't be rsp/r12 (needs a SIB) or rbp/r13 without a displacement
+static void codeModRM(CodeBuilder* code, i64 reg, i64 rm, bool memory, i64 disp8) {
+    if (!memory) {
+        codeByte(code, 0xc0 | (reg & 7) << 3 | (rm & 7));
+    } else {
+        assert((rm & 7) != 4 && (disp8 != 0 || (rm & 7) != 5));
+        assert(disp8 >= -128 && disp8 <= 127);
+        if (disp8 == 0) {
+            codeByte(code, (reg & 7) << 3 | (rm & 7));
+        } else {
+            codeByte(code, 0x40 | (reg & 7) << 3 | (rm & 7));
+            codeByte(code, (u8)disp8);
+        }
+    }
+}
+
+// NOTE(khvorov) reg is the ModRM reg field, vvvv the extra VEX/EVEX source (0 when there isn't one, it's stored
+// inverted so that comes out as the unused 1111). EVEX scales disp8 by the vector size
+static void emitPortOp(CodeBuilder* code, PortTemplate* tmpl, i64 vectorBytes, i64 reg, i64 vvvv, i64 rm, bool memory, i64 disp) {
+    if (vectorBytes == 0) {
+        codeByte(code, 0x48 | ((reg >> 3) & 1) << 2 | ((rm >> 3) & 1));
+        if (tmpl->map == 1) {
+            codeByte(code, 0x0f);
+        }
+        codeByte(code, tmpl->opcode);
+        codeModRM(code, reg, rm, memory, disp);
+    } else if (vectorBytes <= 32) {
+        codeByte(code, 0xc4);
+        codeByte(code, !(reg & 8) << 7 | 1 << 6 | !(rm & 8) << 5 | tmpl->map);
+        codeByte(code, tmpl->w << 7 | (~vvvv & 15) << 3 | (vectorBytes == 32) << 2 | tmpl->pp);
+        codeByte(code, tmpl->opcode);
+        codeModRM(code, reg, rm, memory, disp);
+    } else {
+        assert(disp % vectorBytes == 0);
+        codeByte(code, 0x62);
+        codeByte(code, !(reg & 8) << 7 | 1 << 6 | !(rm & 8) << 5 | !(reg & 16) << 4 | tmpl->map);
+        codeByte(code, tmpl->w << 7 | (~vvvv & 15) << 3 | 1 << 2 | tmpl->pp);
+        codeByte(code, 2 << 5 | !(vvvv & 16) << 3);
+        codeByte(code, tmpl->opcode);
+        codeModRM(code, reg, rm, memory, disp / vectorBytes);
+    }
+}
+
+static void emitPortKernel(CodeBuilder* code, PortTemplate* tmpl, i64 width, i64 count, bool chained) {
+    // NOTE(khvorov) rax and r8-r10 are the independent destinations, r11 the source. All volatile in both ABIs
+    i64 gprDests[] = {0, 8, 9, 10};
+    i64 gprSource = 11;
+    i64 vectorSource = PORT_VECTOR_REGS - 1;
+    bool vector = tmpl->form >= PortForm_VecLoad;
+    i64 vectorBytes = vector ? width / 8 : 0;
+    PortTemplate gprLoad = {.opcode = 0x8b, .w = true};
+    PortTemplate vecLoad = {.map = 1, .pp = 2, .opcode = 0x6f, .w = true};
+
+    if (vector) {
+        for (i64 reg = 0; reg < PORT_VECTOR_REGS; reg++) {
+            emitPortOp(code, &vecLoad, vectorBytes, reg, 0, PORT_BASE_REG, true, tmpl->doubles ? 0 : -64);
+        }
+    } else {
+        for (i64 ind = 0; ind < arrayLen(gprDests); ind++) {
+            emitPortOp(code, &gprLoad, 0, gprDests[ind], 0, PORT_BASE_REG, true, 0);
+        }
+        emitPortOp(code, &gprLoad, 0, gprSource, 0, PORT_BASE_REG, true, 0);
+        if (tmpl->form == PortForm_GprLoad && chained) {
+            emitPortOp(code, &gprLoad, 0, 0, 0, PORT_BASE_REG, true, 64);
+        }
+    }
+
+    i64 loopBegin = code->len;
+    for (i64 ind = 0; ind < count; ind++) {
+        i64 gprDest = chained ? 0 : gprDests[ind % arrayLen(gprDests)];
+        i64 vectorDest = chained ? 0 : ind % (PORT_VECTOR_REGS - 1);
+        switch (tmpl->form) {
+            case PortForm_GprOp: emitPortOp(code, tmpl, 0, gprDest, 0, chained ? 0 : gprSource, false, 0); break;
+            case PortForm_GprLoad: emitPortOp(code, tmpl, 0, gprDest, 0, chained ? 0 : PORT_BASE_REG, true, 0); break;
+            case PortForm_GprStore: emitPortOp(code, tmpl, 0, gprSource, 0, PORT_BASE_REG, true, 0); break;
+            case PortForm_VecLoad: emitPortOp(code, tmpl, vectorBytes, vectorDest, 0, PORT_BASE_REG, true, 0); break;
+            case PortForm_VecStore: emitPortOp(code, tmpl, vectorBytes, vectorSource, 0, PORT_BASE_REG, true, 0); break;
+            case PortForm_VecBinary: emitPortOp(code, tmpl, vectorBytes, vectorDest, chained ? 0 : vectorSource, vectorSource, false, 0); break;
+            case PortForm_VecUnary: emitPortOp(code, tmpl, vectorBytes, vectorDest, 0, chained ? 0 : vectorSource, false, 0); break;
+        }
+    }
+    u8 dec[] = {0x48, 0xff, 0xc8 | PORT_COUNT_REG};
+    codeBytes(code, dec, sizeof(dec));
+    codeJumpIfNotZero(code, loopBegin);
+    if (vector) {
+        u8 vzeroupper[] = {0xc5, 0xf8, 0x77};
+        codeBytes(code, vzeroupper, sizeof(vzeroupper));
+    }
+    codeByte(code, 0xc3);
+}
+
+static bool portFormChains(PortForm form) {
+    bool result = form != PortForm_GprStore && form != PortForm_VecLoad && form != PortForm_VecStore;
     return result;
 }
 
-static u8arr readAndCloseFile(Arena* arena, OpenedFile file) {
-    u8arr result = {.len = file.size};
-    result.ptr = arenaAllocArray(arena, u8, result.len);
-    DWORD bytesRead = 0;
-    BOOL ReadFileResult = ReadFile(file.handle, result.ptr, file.size, &bytesRead, 0);
-    assert(ReadFileResult);
-    assert(bytesRead == result.len);
-    CloseHandle(file.handle);
+static void runPortThroughput(BenchmarkContext* ctx) {
+    i64 codeSize = 4096;
+    u8* codePages = allocFreshPages(codeSize);
+    u8* data = allocFreshPages(4096);
+    u8* base = data + 64;
+
+    printf("port throughput, instructions per cycle by count per iteration, latency is cycles per chained instruction\n");
+    printf("%-24s", "instruction");
+    for (i64 countIndex = 0; countIndex < arrayLen(globalPortCounts); countIndex++) {
+        printf(" %6s%lld", "x", (long long)globalPortCounts[countIndex]);
+    }
+    printf(" %8s\n", "latency");
+
+    for (i64 templateIndex = 0; templateIndex < arrayLen(globalPortTemplates); templateIndex++) {
+        PortTemplate* tmpl = globalPortTemplates + templateIndex;
+        for (i64 width = 64; width <= 512; width *= 2) {
+            u32 widthFlag = (u32)(width / 64);
+            if (!(tmpl->widths & widthFlag)) {
+                continue;
+            }
+            char name[64] = {};
+            snprintf(name, sizeof(name), "%s %lld", tmpl->mnemonic, (long long)width);
+            u32 required = tmpl->features | (width >= 256 ? tmpl->features256 : 0) | (width == 512 ? CpuFeature_AVX512F : 0);
+            if (required & ~ctx->cpuFeatures) {
+                printf("skip: %s unsupported\n", name);
+                continue;
+            }
+
+            printf("%-24s", name);
+            i64 columnCount = arrayLen(globalPortCounts) + 1;
+            for (i64 column = 0; column < columnCount; column++) {
+                bool chained = column == columnCount - 1;
+                i64 count = chained ? globalPortCounts[arrayLen(globalPortCounts) - 1] : globalPortCounts[column];
+                if (chained && !portFormChains(tmpl->form)) {
+                    printf(" %8s", "-");
+                    continue;
+                }
+
+                setPagesExecutable(codePages, codeSize, false);
+                CodeBuilder code = {.base = codePages, .cap = codeSize};
+                emitPortKernel(&code, tmpl, width, count, chained);
+                setPagesExecutable(codePages, codeSize, true);
+
+                AsmCall call = {.kernel = (AsmKernel)(void*)codePages, .ptr = base, .count = PORT_ITERATIONS};
+                u64 best = timeMinTicks(resetPortPage, timedAsmCall, &call, PORT_TRIALS);
+                f64 instructions = (f64)(count * PORT_ITERATIONS);
+                if (chained) {
+                    printf(" %8.3g", (f64)best / instructions);
+                } else {
+                    printf(" %7.3g", instructions / (f64)best);
+                }
+            }
+            printf("\n");
+        }
+    }
+    freeFreshPages(codePages, codeSize);
+    freeFreshPages(data, 4096);
+}
+
+// NOTE(khvorov) Software prefetch. One qword per line at base + offsets[i], sequential, strided by a page and a line
+// (the hardware streamer stops at page boundaries) or a random permutation of the lines in the working set. Every hint
+// runs at 0..64 elements ahead, which is 0..4KB for sequential, against the same loop without the prefetch.
+// A trial is at least PREFETCH_MIN_ELEMENTS loads
+
+#define PREFETCH_MIN_ELEMENTS (1 << 20)
+#define PREFETCH_TRIALS 4
+#define PREFETCH_STRIDE (4096 + 64)
+
+typedef void (*PrefetchKernel)(void* base, i64* offsets, i64 count, i64 distance);
+
+void PrefetchGatherNone(void* base, i64* offsets, i64 count, i64 distance);
+void PrefetchGatherT0(void* base, i64* offsets, i64 count, i64 distance);
+void PrefetchGatherT1(void* base, i64* offsets, i64 count, i64 distance);
+void PrefetchGatherT2(void* base, i64* offsets, i64 count, i64 distance);
+void PrefetchGatherNTA(void* base, i64* offsets, i64 count, i64 distance);
+
+typedef struct PrefetchHint {
+    char* name;
+    PrefetchKernel kernel;
+} PrefetchHint;
+
+static PrefetchHint globalPrefetchHints[] = {
+    {"t0", PrefetchGatherT0},
+    {"t1", PrefetchGatherT1},
+    {"t2", PrefetchGatherT2},
+    {"nta", PrefetchGatherNTA},
+};
+
+typedef enum PrefetchPattern {
+    PrefetchPattern_Sequential,
+    PrefetchPattern_Strided,
+    PrefetchPattern_Random,
+    PrefetchPattern_Count,
+} PrefetchPattern;
+
+static char* globalPrefetchPatternNames[] = {"sequential", "strided", "random"};
+static i64 globalPrefetchDistances[] = {0, 1, 2, 4, 8, 16, 32, 64};
+static i64 globalPrefetchSizes[] = {32 * Kilobyte, 256 * Kilobyte, 4 * Megabyte, 32 * Megabyte, 256 * Megabyte};
+
+typedef struct PrefetchCall {
+    PrefetchKernel kernel;
+    u8* base;
+    i64* offsets;
+    i64 count;
+    i64 distance;
+    i64 passes;
+} PrefetchCall;
+
+static void timedPrefetchPasses(void* data) {
+    PrefetchCall* call = (PrefetchCall*)data;
+    for (i64 pass = 0; pass < call->passes; pass++) {
+        call->kernel(call->base, call->offsets, call->count, call->distance);
+    }
+}
+
+static f64 timePrefetchKernel(PrefetchKernel kernel, u8* base, i64* offsets, i64 count, i64 distance) {
+    PrefetchCall call = {
+        .kernel = kernel,
+        .base = base,
+        .offsets = offsets,
+        .count = count,
+        .distance = distance,
+        .passes = max(1, PREFETCH_MIN_ELEMENTS / count),
+    };
+    u64 best = timeMinTicks(0, timedPrefetchPasses, &call, PREFETCH_TRIALS);
+    f64 result = (f64)best / (f64)(call.passes * count);
     return result;
 }
 
-int main() {
+static void runPrefetchSweep(BenchmarkContext* ctx) {
+    i64 maxSize = 0;
+    for (i64 sizeIndex = 0; sizeIndex < arrayLen(globalPrefetchSizes); sizeIndex++) {
+        maxSize = max(maxSize, globalPrefetchSizes[sizeIndex]);
+    }
+    u8* base = allocPages(maxSize, false);
+    assert(base);
+    memset(base, 1, maxSize);
+    i64 maxDistance = globalPrefetchDistances[arrayLen(globalPrefetchDistances) - 1];
+    i64* offsets = arenaAllocArray(ctx->arena, i64, maxSize / 64 + maxDistance);
+    Rng rng = createRng(maxSize);
+    i64 distanceCount = arrayLen(globalPrefetchDistances);
+    i64 hintCount = arrayLen(globalPrefetchHints);
+
+    for (PrefetchPattern pattern = 0; pattern < PrefetchPattern_Count; pattern++) {
+        printf("\nprefetch %s: cycles per load without prefetch, speedup with it by elements ahead\n%10s %5s %8s", globalPrefetchPatternNames[pattern], "size", "hint", "none");
+        for (i64 distanceIndex = 0; distanceIndex < distanceCount; distanceIndex++) {
+            printf(" %6lld", (long long)globalPrefetchDistances[distanceIndex]);
+        }
+        printf("\n");
+
+        for (i64 sizeIndex = 0; sizeIndex < arrayLen(globalPrefetchSizes); sizeIndex++) {
+            i64 size = globalPrefetchSizes[sizeIndex];
+            i64 count = size / 64;
+            for (i64 ind = 0; ind < count; ind++) {
+                switch (pattern) {
+                    case PrefetchPattern_Sequential: offsets[ind] = ind * 64; break;
+                    case PrefetchPattern_Strided: offsets[ind] = ind * PREFETCH_STRIDE % size; break;
+                    case PrefetchPattern_Random: offsets[ind] = ind * 64; break;
+                    case PrefetchPattern_Count: break;
+                }
+            }
+            if (pattern == PrefetchPattern_Random) {
+                for (i64 ind = count - 1; ind > 0; ind--) {
+                    i64 other = randomU32Bound(&rng, (u32)ind);
+                    i64 temp = offsets[ind];
+                    offsets[ind] = offsets[other];
+                    offsets[other] = temp;
+                }
+            }
+            for (i64 ind = 0; ind < maxDistance; ind++) {
+                offsets[count + ind] = offsets[ind % count];
+            }
+
+            // NOTE(khvorov) The baseline is timed again around every hint and the fastest one counts, comparing
+            // 32 cells against one unlucky baseline would make prefetching look better than it is
+            f64 baseline = timePrefetchKernel(PrefetchGatherNone, base, offsets, count, 0);
+            f64* cycles = arenaAllocArray(ctx->arena, f64, hintCount * distanceCount);
+            for (i64 hintIndex = 0; hintIndex < hintCount; hintIndex++) {
+                for (i64 distanceIndex = 0; distanceIndex < distanceCount; distanceIndex++) {
+                    i64 distance = globalPrefetchDistances[distanceIndex];
+                    cycles[hintIndex * distanceCount + distanceIndex] = timePrefetchKernel(globalPrefetchHints[hintIndex].kernel, base, offsets, count, distance);
+                }
+                baseline = min(baseline, timePrefetchKernel(PrefetchGatherNone, base, offsets, count, 0));
+            }
+
+            f64 bestSpeedup = 1;
+            char* bestHint = 0;
+            i64 bestDistance = 0;
+            for (i64 hintIndex = 0; hintIndex < hintCount; hintIndex++) {
+                PrefetchHint hint = globalPrefetchHints[hintIndex];
+                printf("%8.6gKB %5s %8.3g", (f64)size / 1024.0, hint.name, baseline);
+                for (i64 distanceIndex = 0; distanceIndex < distanceCount; distanceIndex++) {
+                    f64 speedup = baseline / cycles[hintIndex * distanceCount + distanceIndex];
+                    printf(" %6.3g", speedup);
+                    if (speedup > bestSpeedup) {
+                        bestSpeedup = speedup;
+                        bestHint = hint.name;
+                        bestDistance = globalPrefetchDistances[distanceIndex];
+                    }
+                }
+                printf("\n");
+            }
+
+            // NOTE(khvorov) Under 5% is within what the trials move around by, call that the hardware prefetcher winning
+            if (bestHint && bestSpeedup > 1.05) {
+                printf(
+                    "%8.6gKB best: %s %lld ahead (%lldB sequential), %.3gx over hardware alone\n",
+                    (f64)size / 1024.0,
+                    bestHint,
+                    (long long)bestDistance,
+                    (long long)(bestDistance * 64),
+                    bestSpeedup
+                );
+            } else {
+                printf("%8.6gKB best: hardware prefetcher alone\n", (f64)size / 1024.0);
+            }
+        }
+    }
+    freePages(base, maxSize, false);
+}
+
+// NOTE(khvorov) Only * and ?, enough to pick benchmarks by name
+static bool globMatch(char* pattern, char* str) {
+    char* starPattern = 0;
+    char* starStr = 0;
+    while (*str) {
+        if (*pattern == '*') {
+            starPattern = ++pattern;
+            starStr = str;
+        } else if (*pattern == '?' || *pattern == *str) {
+            pattern++;
+            str++;
+        } else if (starPattern) {
+            pattern = starPattern;
+            str = ++starStr;
+        } else {
+            return false;
+        }
+    }
+    while (*pattern == '*') {
+        pattern++;
+    }
+    return *pattern == '\0';
+}
+
+static void writeBenchmarkCsv(char* path, BenchmarkResult* results, i64 resultCount) {
+    FILE* file = fopen(path, "wb");
+    assert(file);
+    fprintf(file, "name,mode,runs,bytes,minSec,meanSec,medianSec,medianLowSec,medianHighSec,maxSec,stddevSec,outliers,minPF,maxPF,minGBs,medianGBs,stopPolicy,stopValue,stopCapSec,capped,supported\n");
+    for (i64 ind = 0; ind < resultCount; ind++) {
+        BenchmarkResult* result = results + ind;
+        RepeatStats* stats = &result->stats;
+        f64 sizeGB = (f64)result->bytes / (1024.0 * 1024.0 * 1024.0);
+        fprintf(
+            file,
+            "%s,%s,%llu,%lld,%g,%g,%g,%g,%g,%g,%g,%lld,%llu,%llu,%g,%g,%s,%g,%g,%d,%d\n",
+            result->name,
+            globalBenchmarkModeNames[result->mode],
+            (unsigned long long)result->runs,
+            (long long)result->bytes,
+            stats->minSec,
+            stats->meanSec,
+            stats->medianSec,
+            stats->medianLowSec,
+            stats->medianHighSec,
+            stats->maxSec,
+            stats->stddevSec,
+            (long long)stats->outlierCount,
+            (unsigned long long)result->minPF,
+            (unsigned long long)result->maxPF,
+            stats->minSec > 0 ? sizeGB / stats->minSec : 0,
+            stats->medianSec > 0 ? sizeGB / stats->medianSec : 0,
+            globalRepeatStopKindNames[result->stopPolicy.kind],
+            result->stopPolicy.value,
+            result->stopPolicy.capSec,
+            result->capped,
+            !result->unsupported
+        );
+    }
+    fclose(file);
+}
+
+static void writeBenchmarkJson(char* path, BenchmarkResult* results, i64 resultCount) {
+    FILE* file = fopen(path, "wb");
+    assert(file);
+    fprintf(file, "[\n");
+    for (i64 ind = 0; ind < resultCount; ind++) {
+        BenchmarkResult* result = results + ind;
+        RepeatStats* stats = &result->stats;
+        f64 sizeGB = (f64)result->bytes / (1024.0 * 1024.0 * 1024.0);
+        fprintf(
+            file,
+            "    {\"name\": \"%s\", \"mode\": \"%s\", \"runs\": %llu, \"bytes\": %lld, \"minSec\": %g, \"meanSec\": %g, \"medianSec\": %g, "
+            "\"medianLowSec\": %g, \"medianHighSec\": %g, \"maxSec\": %g, \"stddevSec\": %g, \"outliers\": %lld, "
+            "\"minPF\": %llu, \"maxPF\": %llu, \"minGBs\": %g, \"medianGBs\": %g, "
+            "\"stopPolicy\": \"%s\", \"stopValue\": %g, \"stopCapSec\": %g, \"capped\": %s, \"supported\": %s}%s\n",
+            result->name,
+            globalBenchmarkModeNames[result->mode],
+            (unsigned long long)result->runs,
+            (long long)result->bytes,
+            stats->minSec,
+            stats->meanSec,
+            stats->medianSec,
+            stats->medianLowSec,
+            stats->medianHighSec,
+            stats->maxSec,
+            stats->stddevSec,
+            (long long)stats->outlierCount,
+            (unsigned long long)result->minPF,
+            (unsigned long long)result->maxPF,
+            stats->minSec > 0 ? sizeGB / stats->minSec : 0,
+            stats->medianSec > 0 ? sizeGB / stats->medianSec : 0,
+            globalRepeatStopKindNames[result->stopPolicy.kind],
+            result->stopPolicy.value,
+            result->stopPolicy.capSec,
+            result->capped ? "true" : "false",
+            result->unsupported ? "false" : "true",
+            ind < resultCount - 1 ? "," : ""
+        );
+    }
+    fprintf(file, "]\n");
+    fclose(file);
+}
+
+// NOTE(khvorov) Every cycle count pawp prints, here and in the latency, stride, code alignment, ports and prefetch
+// tables, is TSC ticks and not core clocks. The TSC runs at a fixed rate, so with turbo a core cycle is less than a
+// tick and the numbers read low, and with the core clocked down they read high. Compare them within a run, not
+// against instruction tables
+static void printBenchmarkReport(BenchmarkResult* results, i64 resultCount, u64 rdtscFrequencyPerSecond) {
+    printf("\n%-48s %-6s %14s %14s %10s %10s\n", "name", "mode", "cycles/B min", "cycles/B med", "GB/s min", "GB/s med");
+    f64 freq = (f64)rdtscFrequencyPerSecond;
+    for (i64 ind = 0; ind < resultCount; ind++) {
+        BenchmarkResult* result = results + ind;
+        if (result->unsupported) {
+            printf("%-48s %-6s %14s\n", result->name, globalBenchmarkModeNames[result->mode], "unsupported");
+            continue;
+        }
+        f64 bytes = (f64)result->bytes;
+        f64 sizeGB = bytes / (1024.0 * 1024.0 * 1024.0);
+        printf(
+            "%-48s %-6s %14.4g %14.4g %10.3g %10.3g\n",
+            result->name,
+            globalBenchmarkModeNames[result->mode],
+            result->stats.minSec * freq / bytes,
+            result->stats.medianSec * freq / bytes,
+            sizeGB / result->stats.minSec,
+            sizeGB / result->stats.medianSec
+        );
+    }
+}
+
+static void printUsage(void) {
+    printf(
+        "usage: pawp [--list] [--gen-input] [--input path] [--mode warm|cold|fresh]... [--cache] [--sizes list] [--sweep-steps n] [--latency] [--stores] [--stride] [--branches] [--code-align] [--ports] [--prefetch] [--scaling] [--threads n] [--stop kind:value] [--stop-cap sec] [--pair a b] [--csv path] [--json path] [pattern...]\n"
+        "    runs every benchmark whose name matches one of the glob patterns, only WriteLoop when none are given\n"
+        "    and no harness is requested ('*' runs all of them, including the 1GB bandwidth tests, see --list)\n"
+        "    in every requested mode (warm when none are given). cold flushes the bytes the kernel touches before every run,\n"
+        "    fresh hands it never touched pages every run. Read-only kernels see the shared zero page there, so fresh\n"
+        "    shows their read faults but not the cost of allocating real pages. Asm benchmarks set up a pattern in the buffer\n"
+        "    that fresh pages wouldn't have, so they're skipped in fresh\n"
+        "    --input (default input.json, --gen-input writes it) is read by ReadFile, and once at the end when --input\n"
+        "    or --gen-input is given. Without the file ReadFile is skipped\n"
+        "    --stop is one of min-unchanged:sec, iterations:n, wall-time:sec, median-ci:percent (default min-unchanged:1),\n"
+        "    every policy also stops at --stop-cap seconds (default 30, 0 for none)\n"
+        "    --pair runs the first benchmarks matching a and b interleaved and reports the B/A ratio distribution\n"
+        "    --cache sweeps working set sizes (--sizes list like 48K,1.5M,24M or --sweep-steps n per octave, default 4)\n"
+        "    and reports the cache levels it finds\n"
+        "    --latency times dependent loads through a random pointer chain at line and page granularity, 4K and huge pages\n"
+        "    over the same kind of sizes (default 2 steps per octave), huge rows that THP didn't back are labelled thp-advised\n"
+        "    --stores compares read, vmovdqu, rep stosb and non-temporal store bandwidth over the same kind of sizes\n"
+        "    --stride prints the K loads x stride S cycles per load heat map for set conflicts and the 4K aliasing offsets\n"
+        "    --branches runs periodic, random and nested loop branch patterns through ConditionalNopAsm\n"
+        "    --code-align generates the MOVAllBytesAsm loop at every offset 0..63 and a few loop sizes and times each one\n"
+        "    --ports generates load, store, ALU, shuffle and FP kernels per width and prints instructions per cycle\n"
+        "    --prefetch times sequential, strided and random loads with prefetcht0/t1/t2/nta 0..64 elements ahead\n"
+        "    --scaling adds the multithreaded bandwidth sweep over 1..n pinned threads (n defaults to the core count)\n"
+    );
+}
+
+int main(int argc, char** argv) {
+    globalProfile.timeStart = __rdtsc();
+
     Arena arena_ = {.size = 10 * Gigabyte};
     Arena* arena = &arena_;
     {
+#ifdef _WIN32
         HANDLE tokenHandle = 0;
         BOOL OpenProcessTokenResult = OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES, &tokenHandle);
         assert(OpenProcessTokenResult);
@@ -430,10 +4187,17 @@ int main() {
 
         arena->base = VirtualAlloc(0, arena->size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
         assert(arena->base);
+#else
+        // NOTE(khvorov) Transparent huge pages are the closest to MEM_LARGE_PAGES without reserving hugetlbfs pages
+        arena->base = mmap(0, arena->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        assert(arena->base != MAP_FAILED);
+        madvise(arena->base, arena->size, MADV_HUGEPAGE);
+#endif
     }
 
     u64 rdtscFrequencyPerSecond = 0;
     {
+#ifdef _WIN32
         LARGE_INTEGER pcountStart = {};
         QueryPerformanceCounter(&pcountStart);
         u64 rdtscStart = __rdtsc();
@@ -449,13 +4213,163 @@ int main() {
         QueryPerformanceFrequency(&pfreq);
 
         f64 secondsElapsed = (f64)pdiff / (f64)pfreq.QuadPart;
+#else
+        struct timespec timeStart = {};
+        clock_gettime(CLOCK_MONOTONIC_RAW, &timeStart);
+        u64 rdtscStart = __rdtsc();
+        usleep(100 * 1000);
+        struct timespec timeEnd = {};
+        clock_gettime(CLOCK_MONOTONIC_RAW, &timeEnd);
+        u64 rdtscEnd = __rdtsc();
+
+        u64 rdtscDiff = rdtscEnd - rdtscStart;
+        f64 secondsElapsed = (f64)(timeEnd.tv_sec - timeStart.tv_sec) + (f64)(timeEnd.tv_nsec - timeStart.tv_nsec) / 1e9;
+#endif
         rdtscFrequencyPerSecond = (f64)rdtscDiff / (f64)secondsElapsed;
         printf("rdtsc freq: %llu\n", (unsigned long long)rdtscFrequencyPerSecond);
     }
 
-    char* inputPath = "input.json";
+#ifdef PAWP_PROFILE_SAMPLE
+    profileSamplingBegin(1000);
+#endif
+
+#ifdef PAWP_PROFILE_PMC
+    {
+        PmcKind kinds[PmcKind_Count] = {};
+        char* events = getenv("PAWP_PROFILE_PMC_EVENTS");
+        i64 kindCount = pmcParseKinds(events ? events : "cycles,instr,brmiss,l1dmiss,llcmiss,dtlbmiss", kinds);
+        if (kindCount > 0) {
+            profileOpenCounters(kinds, kindCount);
+        }
+    }
+#endif
 
+    char* inputPath = "input.json";
+    bool inputRequested = false;
+    char* csvPath = 0;
+    char* jsonPath = 0;
+    bool listBenchmarks = false;
     bool generateInput = false;
+    bool modes[BenchmarkMode_Count] = {};
+    bool anyMode = false;
+    bool bandwidthScaling = false;
+    bool cacheSweep = false;
+    char* sweepSizeList = 0;
+    i64 sweepSteps = 0;
+    bool latencySweep = false;
+    bool storeSweep = false;
+    bool strideSweep = false;
+    bool branchPatterns = false;
+    bool codeAlign = false;
+    bool portThroughput = false;
+    bool prefetchSweep = false;
+    i64 scalingThreads = 0;
+    RepeatStopPolicy stopPolicy = REPEAT_DEFAULT_STOP_POLICY;
+    char* pairPatterns[2] = {};
+    char** patterns = arenaAllocArray(arena, char*, argc);
+    i64 patternCount = 0;
+    for (i64 argIndex = 1; argIndex < argc; argIndex++) {
+        char* arg = argv[argIndex];
+        bool hasValue = argIndex + 1 < argc;
+        if (strcmp(arg, "--list") == 0) {
+            listBenchmarks = true;
+        } else if (strcmp(arg, "--gen-input") == 0) {
+            generateInput = true;
+            inputRequested = true;
+        } else if (strcmp(arg, "--input") == 0 && hasValue) {
+            inputPath = argv[++argIndex];
+            inputRequested = true;
+        } else if (strcmp(arg, "--mode") == 0 && hasValue) {
+            char* modeName = argv[++argIndex];
+            bool found = false;
+            for (BenchmarkMode mode = 0; mode < BenchmarkMode_Count && !found; mode++) {
+                if (strcmp(modeName, globalBenchmarkModeNames[mode]) == 0) {
+                    modes[mode] = true;
+                    found = true;
+                }
+            }
+            if (!found) {
+                printUsage();
+                return 1;
+            }
+            anyMode = true;
+        } else if (strcmp(arg, "--cache") == 0) {
+            cacheSweep = true;
+        } else if (strcmp(arg, "--sizes") == 0 && hasValue) {
+            sweepSizeList = argv[++argIndex];
+        } else if (strcmp(arg, "--sweep-steps") == 0 && hasValue) {
+            sweepSteps = atoll(argv[++argIndex]);
+        } else if (strcmp(arg, "--latency") == 0) {
+            latencySweep = true;
+        } else if (strcmp(arg, "--stores") == 0) {
+            storeSweep = true;
+        } else if (strcmp(arg, "--stride") == 0) {
+            strideSweep = true;
+        } else if (strcmp(arg, "--branches") == 0) {
+            branchPatterns = true;
+        } else if (strcmp(arg, "--code-align") == 0) {
+            codeAlign = true;
+        } else if (strcmp(arg, "--ports") == 0) {
+            portThroughput = true;
+        } else if (strcmp(arg, "--prefetch") == 0) {
+            prefetchSweep = true;
+        } else if (strcmp(arg, "--scaling") == 0) {
+            bandwidthScaling = true;
+        } else if (strcmp(arg, "--threads") == 0 && hasValue) {
+            scalingThreads = atoll(argv[++argIndex]);
+        } else if (strcmp(arg, "--stop") == 0 && hasValue) {
+            char* policyArg = argv[++argIndex];
+            char* separator = strchr(policyArg, ':');
+            i64 kindLen = separator ? separator - policyArg : (i64)strlen(policyArg);
+            bool found = false;
+            for (RepeatStopKind kind = 0; kind < RepeatStopKind_Count && !found; kind++) {
+                char* kindName = globalRepeatStopKindNames[kind];
+                if ((i64)strlen(kindName) == kindLen && memcmp(kindName, policyArg, kindLen) == 0) {
+                    stopPolicy.kind = kind;
+                    found = true;
+                }
+            }
+            if (!found || !separator) {
+                printUsage();
+                return 1;
+            }
+            stopPolicy.value = atof(separator + 1);
+        } else if (strcmp(arg, "--stop-cap") == 0 && hasValue) {
+            stopPolicy.capSec = atof(argv[++argIndex]);
+        } else if (strcmp(arg, "--pair") == 0 && argIndex + 2 < argc) {
+            pairPatterns[0] = argv[++argIndex];
+            pairPatterns[1] = argv[++argIndex];
+        } else if (strcmp(arg, "--csv") == 0 && hasValue) {
+            csvPath = argv[++argIndex];
+        } else if (strcmp(arg, "--json") == 0 && hasValue) {
+            jsonPath = argv[++argIndex];
+        } else if (arg[0] == '-') {
+            printUsage();
+            return 1;
+        } else {
+            patterns[patternCount++] = arg;
+        }
+    }
+    if (!anyMode) {
+        modes[BenchmarkMode_Warm] = true;
+    }
+
+    if (listBenchmarks) {
+        u32 cpuFeatures = getCpuFeatures();
+        for (i64 ind = 0; ind < arrayLen(globalBenchmarks); ind++) {
+            Benchmark* bench = globalBenchmarks + ind;
+            printf("%s", bench->name);
+            u32 missing = bench->requiredFeatures & ~cpuFeatures;
+            if (missing) {
+                printf(" (unsupported, needs");
+                printCpuFeatures(missing);
+                printf(")");
+            }
+            printf("\n");
+        }
+        return 0;
+    }
+
     if (generateInput) tempMemBlock(arena) {
         i64 pairCount = 1000000;
         i64 seed = 8;
@@ -480,7 +4394,7 @@ int main() {
         }
 
         f64 expectedAverage = 0;
-        for (i64 ind = 0; ind < pairCount; ind++) {
+        for (i64 ind = 0; ind < pairCount; ind++) profileThroughputHist("genPair", sizeof(Pair)) {
             Pair pair = {
                 .x0 = randomF3201(&rng) * xrange + xmin,
                 .x1 = randomF3201(&rng) * xrange + xmin,
@@ -517,504 +4431,193 @@ int main() {
         // TODO(khvorov) Write out reference values as well I guess
     }
 
-    bool repeatTestReadFile = false;
-    if (repeatTestReadFile) {
-        OpenedFile openedInputFile = openFile(inputPath);
-        RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, openedInputFile.size, STR("Read file"));
-        RepetitionTester* tester = &tester_;
-        CloseHandle(openedInputFile.handle);
+    BenchmarkContext benchContext = {
+        .arena = arena,
+        .rdtscFrequencyPerSecond = rdtscFrequencyPerSecond,
+        .inputPath = inputPath,
+        .stopPolicy = stopPolicy,
+        .cpuFeatures = getCpuFeatures(),
+    };
+    printf("cpu features:");
+    printCpuFeatures(benchContext.cpuFeatures);
+    printf("\n");
+    OpenedFile probedInputFile = {};
+    bool inputExists = tryOpenFile(inputPath, &probedInputFile);
+    if (inputExists) {
+        closeFile(probedInputFile);
+    }
+    i64 sweepSizeCap = 256;
+    i64* sweepSizes = arenaAllocArray(arena, i64, sweepSizeCap);
+    i64 sweepSizeCount = 0;
+    i64* coarseSizes = arenaAllocArray(arena, i64, sweepSizeCap);
+    i64 coarseSizeCount = 0;
+    if (sweepSizeList) {
+        sweepSizeCount = parseSizeList(sweepSizeList, sweepSizes, sweepSizeCap);
+        if (sweepSizeCount < 0) {
+            printUsage();
+            return 1;
+        }
+        coarseSizes = sweepSizes;
+        coarseSizeCount = sweepSizeCount;
+    } else {
+        sweepSizeCount = makeCacheSweepSizes(sweepSizes, sweepSizeCap, sweepSteps ? sweepSteps : CACHE_SWEEP_STEPS_PER_OCTAVE, 512 * Megabyte);
+        coarseSizeCount = makeCacheSweepSizes(coarseSizes, sweepSizeCap, sweepSteps ? sweepSteps : COARSE_SWEEP_STEPS_PER_OCTAVE, 512 * Megabyte);
+    }
+    bool anyHarness = bandwidthScaling || cacheSweep || latencySweep || storeSweep || strideSweep || branchPatterns || codeAlign || portThroughput || prefetchSweep || pairPatterns[0];
+    // NOTE(khvorov) A bare run does what pawp did before there was a registry
+    if (patternCount == 0 && !anyHarness) {
+        patterns[patternCount++] = "WriteLoop";
+    }
 
-        while (!repeatShouldStop(tester)) tempMemBlock(arena) {
+    i64 resultCap = (arrayLen(globalBenchmarks) + 2) * BenchmarkMode_Count + BANDWIDTH_MAX_THREADS * (CACHE_MAX_LEVELS + 1) * 2
+        + sweepSizeCount + coarseSizeCount * (arrayLen(globalLatencyVariants) + arrayLen(globalStoreVariants))
+        + arrayLen(globalBranchPatterns);
+    BenchmarkResult* results = arenaAllocArray(arena, BenchmarkResult, resultCap);
+    i64 resultCount = 0;
+    for (i64 benchIndex = 0; benchIndex < arrayLen(globalBenchmarks); benchIndex++) {
+        Benchmark* bench = globalBenchmarks + benchIndex;
+        bool selected = false;
+        for (i64 patternIndex = 0; patternIndex < patternCount && !selected; patternIndex++) {
+            selected = globMatch(patterns[patternIndex], bench->name);
+        }
+        if (!selected) {
+            continue;
+        }
 
-            repeatBeginTime(tester);
-            OpenedFile file = openFile(inputPath);
-            u8arr content = readAndCloseFile(arena, file);
-            repeatEndTime(tester);
+        u32 missing = bench->requiredFeatures & ~benchContext.cpuFeatures;
+        bool missingInput = bench->usesInput && !inputExists;
+        inputRequested = inputRequested || (bench->usesInput && inputExists);
+        if (missing || missingInput) {
+            if (missing) {
+                printf("skip: %s unsupported, needs", bench->name);
+                printCpuFeatures(missing);
+                printf("\n");
+            } else {
+                printf("skip: %s needs %s, make it with --gen-input\n", bench->name, inputPath);
+            }
+            for (BenchmarkMode mode = 0; mode < BenchmarkMode_Count; mode++) {
+                if (modes[mode]) {
+                    results[resultCount++] = (BenchmarkResult) {.name = bench->name, .mode = mode, .unsupported = true};
+                }
+            }
+            continue;
+        }
 
-            assert(tester->expectedSize == (u64)content.len);
-        }
-
-        repeatPrint(tester);
-    }
-
-    bool repeatTestWriteToMem = true;
-    if (repeatTestWriteToMem) tempMemBlock(arena) {
-        i64 bufSize = 1 * Gigabyte;
-        u8* buf = arenaAllocArray(arena, u8, bufSize);
-
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("normal loop"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         for (i64 ind = 0; ind < bufSize; ind++) {
-        //             buf[ind] = ind;
-        //         }
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("MOVAllBytesAsm"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void MOVAllBytesAsm(void* ptr, i64 bufSize);
-        //         MOVAllBytesAsm(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("NOP3x1AllBytesAsm"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void NOP3x1AllBytesAsm(void* ptr, i64 bufSize);
-        //         NOP3x1AllBytesAsm(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("NOP1x3AllBytesAsm"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void NOP1x3AllBytesAsm(void* ptr, i64 bufSize);
-        //         NOP1x3AllBytesAsm(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("NOP1x9AllBytesAsm"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void NOP1x9AllBytesAsm(void* ptr, i64 bufSize);
-        //         NOP1x9AllBytesAsm(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("CMPAllBytesAsm"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void CMPAllBytesAsm(void* ptr, i64 bufSize);
-        //         CMPAllBytesAsm(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-        
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("DECAllBytesAsm"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void DECAllBytesAsm(void* ptr, i64 bufSize);
-        //         DECAllBytesAsm(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-
-        // memset(buf, 0, bufSize);
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("ConditionalNopAsm Never taken"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void ConditionalNopAsm(void* ptr, i64 bufSize);
-        //         ConditionalNopAsm(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-
-        // memset(buf, 1, bufSize);
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("ConditionalNopAsm Always taken"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void ConditionalNopAsm(void* ptr, i64 bufSize);
-        //         ConditionalNopAsm(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 2) {buf[ind] = 1;}
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("ConditionalNopAsm Every 2"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void ConditionalNopAsm(void* ptr, i64 bufSize);
-        //         ConditionalNopAsm(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 3) {buf[ind] = 1;}
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("ConditionalNopAsm Every 3"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void ConditionalNopAsm(void* ptr, i64 bufSize);
-        //         ConditionalNopAsm(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 4) {buf[ind] = 1;}
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("ConditionalNopAsm Every 4"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void ConditionalNopAsm(void* ptr, i64 bufSize);
-        //         ConditionalNopAsm(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 1) {
-        //     BCryptGenRandom(0, buf + ind, 1, BCRYPT_USE_SYSTEM_PREFERRED_RNG);
-        // }
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("ConditionalNopAsm Bcrypt"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void ConditionalNopAsm(void* ptr, i64 bufSize);
-        //         ConditionalNopAsm(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 1) {
-        //     buf[ind] = rand();
-        // }
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("ConditionalNopAsm rand"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void ConditionalNopAsm(void* ptr, i64 bufSize);
-        //         ConditionalNopAsm(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 1) {
-        //     buf[ind] = rand();
-        // }
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("MOVAllBytesAsmAlign64"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void MOVAllBytesAsmAlign64(void* ptr, i64 bufSize);
-        //         MOVAllBytesAsmAlign64(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 1) {
-        //     buf[ind] = rand();
-        // }
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("MOVAllBytesAsmAlign64Nop"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void MOVAllBytesAsmAlign64Nop(void* ptr, i64 bufSize);
-        //         MOVAllBytesAsmAlign64Nop(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-        
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 1) {
-        //     buf[ind] = rand();
-        // }
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("StoreManyTimesX1"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void StoreManyTimesX1(void* ptr, i64 bufSize);
-        //         StoreManyTimesX1(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-                
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 1) {
-        //     buf[ind] = rand();
-        // }
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("StoreManyTimesX2"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void StoreManyTimesX2(void* ptr, i64 bufSize);
-        //         StoreManyTimesX2(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-                        
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 1) {
-        //     buf[ind] = rand();
-        // }
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("StoreManyTimesX3"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void StoreManyTimesX3(void* ptr, i64 bufSize);
-        //         StoreManyTimesX3(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-                                
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 1) {
-        //     buf[ind] = rand();
-        // }
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("StoreManyTimesX4"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void StoreManyTimesX4(void* ptr, i64 bufSize);
-        //         StoreManyTimesX4(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-                
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 1) {
-        //     buf[ind] = rand();
-        // }
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("LoadManyTimesX1"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void LoadManyTimesX1(void* ptr, i64 bufSize);
-        //         LoadManyTimesX1(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-                
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 1) {
-        //     buf[ind] = rand();
-        // }
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("LoadManyTimesX2"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void LoadManyTimesX2(void* ptr, i64 bufSize);
-        //         LoadManyTimesX2(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-                        
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 1) {
-        //     buf[ind] = rand();
-        // }
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("LoadManyTimesX3"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void LoadManyTimesX3(void* ptr, i64 bufSize);
-        //         LoadManyTimesX3(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-                                
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 1) {
-        //     buf[ind] = rand();
-        // }
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("LoadManyTimesX4"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void LoadManyTimesX4(void* ptr, i64 bufSize);
-        //         LoadManyTimesX4(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-                
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 1) {
-        //     buf[ind] = rand();
-        // }
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("StoreManyTimesX2_64"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void StoreManyTimesX2_64(void* ptr, i64 bufSize);
-        //         StoreManyTimesX2_64(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-                                        
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 1) {
-        //     buf[ind] = rand();
-        // }
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("StoreManyTimesX2_128"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void StoreManyTimesX2_128(void* ptr, i64 bufSize);
-        //         StoreManyTimesX2_128(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-                        
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 1) {
-        //     buf[ind] = rand();
-        // }
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("LoadManyTimesX2_64"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void LoadManyTimesX2_64(void* ptr, i64 bufSize);
-        //         LoadManyTimesX2_64(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-                                        
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 1) {
-        //     buf[ind] = rand();
-        // }
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("LoadManyTimesX2_128"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void LoadManyTimesX2_128(void* ptr, i64 bufSize);
-        //         LoadManyTimesX2_128(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-                                
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 1) {
-        //     buf[ind] = rand();
-        // }
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("LoadManyTimesX2_256"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void LoadManyTimesX2_256(void* ptr, i64 bufSize);
-        //         LoadManyTimesX2_256(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-                                        
-        // memset(buf, 0, bufSize);
-        // for (i64 ind = 0; ind < bufSize; ind += 1) {
-        //     buf[ind] = rand();
-        // }
-        // {
-        //     RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, STR("LoadManyTimesX2_512"));
-        //     RepetitionTester* tester = &tester_;
-        //     while (!repeatShouldStop(tester)) {
-        //         repeatBeginTime(tester);
-        //         void LoadManyTimesX2_512(void* ptr, i64 bufSize);
-        //         LoadManyTimesX2_512(buf, bufSize);
-        //         repeatEndTime(tester);
-        //     }
-        //     repeatPrint(tester);
-        // }
-
-                                 
-        memset(buf, 0, bufSize);
-        for (i64 ind = 0; ind < bufSize; ind += 1) {
-            buf[ind] = rand();
-        }
-        {
-            i64 bufSizes[] = {1 << 16, 1 << 20, 1 << 21, 1 << 22, 1 << 23, 1 << 24, 1 << 25, 1 << 26, 1 << 27, 1 << 30};
-            StrBuilder gstr = {.cap = 1024};
-            gstr.ptr = arenaAlloc(arena, gstr.cap);
-            for (i64 bufSizeIndex = 0; bufSizeIndex < (i64)ARRAYSIZE(bufSizes); bufSizeIndex++) {
-                i64 thisBufSize = bufSizes[bufSizeIndex];
-                buildStr(&gstr, "BandwidthTest %lluKB", thisBufSize / 1024);
-                RepetitionTester tester_ = createRepetitionTester(rdtscFrequencyPerSecond, bufSize, (Str) {gstr.ptr, gstr.len});
-                RepetitionTester* tester = &tester_;
-                while (!repeatShouldStop(tester)) {
-                    repeatBeginTime(tester);
-                    void BandwidthTest(void* ptr, i64 bufSize, i64 mask);
-                    BandwidthTest(buf, bufSize, thisBufSize - 1);
-                    repeatEndTime(tester);
+        if (bench->usesBuffer) {
+            benchmarkEnsureBuffer(&benchContext, benchmarkFillBytes(bench));
+        }
+        for (BenchmarkMode mode = 0; mode < BenchmarkMode_Count; mode++) {
+            if (!modes[mode]) {
+                continue;
+            }
+            if (benchmarkSupportsMode(bench, mode)) {
+                results[resultCount++] = runBenchmark(&benchContext, bench, mode);
+            } else {
+                printf("skip: %s [%s], its setup lays out the buffer and fresh pages would lose that\n", bench->name, globalBenchmarkModeNames[mode]);
+                results[resultCount++] = (BenchmarkResult) {.name = bench->name, .mode = mode, .unsupported = true};
+            }
+        }
+    }
+    if (pairPatterns[0]) {
+        Benchmark* pair[2] = {};
+        for (i64 pairIndex = 0; pairIndex < 2; pairIndex++) {
+            for (i64 benchIndex = 0; benchIndex < arrayLen(globalBenchmarks) && !pair[pairIndex]; benchIndex++) {
+                if (globMatch(pairPatterns[pairIndex], globalBenchmarks[benchIndex].name)) {
+                    pair[pairIndex] = globalBenchmarks + benchIndex;
                 }
-                repeatPrint(tester);
-                gstr.len = 0;
+            }
+            if (!pair[pairIndex]) {
+                printf("no benchmark matches %s\n", pairPatterns[pairIndex]);
+                return 1;
+            }
+            if (pair[pairIndex]->requiredFeatures & ~benchContext.cpuFeatures) {
+                printf("%s is unsupported on this cpu\n", pair[pairIndex]->name);
+                return 1;
+            }
+            if (pair[pairIndex]->usesInput && !inputExists) {
+                printf("%s needs %s, make it with --gen-input\n", pair[pairIndex]->name, inputPath);
+                return 1;
+            }
+            inputRequested = inputRequested || pair[pairIndex]->usesInput;
+        }
+        if (pair[0]->usesBuffer || pair[1]->usesBuffer) {
+            benchmarkEnsureBuffer(&benchContext, max(benchmarkFillBytes(pair[0]), benchmarkFillBytes(pair[1])));
+        }
+        for (BenchmarkMode mode = 0; mode < BenchmarkMode_Count; mode++) {
+            if (modes[mode] && !(benchmarkSupportsMode(pair[0], mode) && benchmarkSupportsMode(pair[1], mode))) {
+                printf("skip: pair [%s], fresh pages would lose the buffer layout one of them sets up\n", globalBenchmarkModeNames[mode]);
+            } else if (modes[mode]) {
+                runPaired(&benchContext, pair[0], pair[1], mode, results + resultCount);
+                resultCount += 2;
             }
         }
     }
+    if (cacheSweep) {
+        resultCount += detectCacheHierarchy(&benchContext, &globalCacheHierarchy, sweepSizes, sweepSizeCount, results + resultCount);
+    }
+    if (latencySweep) {
+        resultCount += runLatencySweep(&benchContext, &globalCacheHierarchy, coarseSizes, coarseSizeCount, results + resultCount);
+    }
+    if (storeSweep) {
+        resultCount += runStoreSweep(&benchContext, coarseSizes, coarseSizeCount, results + resultCount);
+    }
+    if (strideSweep) {
+        runStrideSweep(&benchContext);
+    }
+    if (branchPatterns) {
+        resultCount += runBranchPatterns(&benchContext, results + resultCount);
+    }
+    if (codeAlign) {
+        runCodeAlignSweep(&benchContext);
+    }
+    if (portThroughput) {
+        runPortThroughput(&benchContext);
+    }
+    if (prefetchSweep) {
+        runPrefetchSweep(&benchContext);
+    }
+    if (bandwidthScaling) {
+        i64 maxThreads = scalingThreads > 0 ? scalingThreads : getCoreCount();
+        BandwidthScalingSize scalingSizes[CACHE_MAX_LEVELS + 1] = {};
+        i64 scalingSizeCount = makeBandwidthScalingSizes(&benchContext, &globalCacheHierarchy, scalingSizes);
+        resultCount += runBandwidthScaling(&benchContext, maxThreads, scalingSizes, scalingSizeCount, results + resultCount);
+    }
+    if (resultCount > 0) {
+        printBenchmarkReport(results, resultCount, rdtscFrequencyPerSecond);
+    }
+    if (csvPath) {
+        writeBenchmarkCsv(csvPath, results, resultCount);
+    }
+    if (jsonPath) {
+        writeBenchmarkJson(jsonPath, results, resultCount);
+    }
 
-    tempMemBlock(arena) {
-        OpenedFile openedInputFile = openFile(inputPath);
-        profileThroughput("read input", openedInputFile.size) {
-            u8arr inputContent = readAndCloseFile(arena, openedInputFile);
+
+    // NOTE(khvorov) Only when something asked for the input, benchmarks that don't need it shouldn't need the file
+    if (inputRequested) {
+        OpenedFile openedInputFile = {};
+        if (tryOpenFile(inputPath, &openedInputFile)) {
+            tempMemBlock(arena) {
+                profileThroughput("read input", openedInputFile.size) {
+                    u8arr inputContent = readAndCloseFile(arena, openedInputFile);
+                    assert(inputContent.len == openedInputFile.size);
+                }
+            }
+        } else {
+            printf("skip: read input, %s isn't there, make it with --gen-input\n", inputPath);
         }
     }
 
-    profileEnd(arena, rdtscFrequencyPerSecond);
+    ProfileReportSpec profileReportSpec = {
+        .resultsPath = getenv("PAWP_PROFILE_RESULTS"),
+        .baselinePath = getenv("PAWP_PROFILE_BASELINE"),
+        .thresholdPercent = 5.0,
+    };
+    if (getenv("PAWP_PROFILE_THRESHOLD")) {
+        profileReportSpec.thresholdPercent = strtod(getenv("PAWP_PROFILE_THRESHOLD"), 0);
+    }
+    profileEnd(arena, rdtscFrequencyPerSecond, profileReportSpec);
+#ifdef PAWP_PROFILE_SAMPLE
+    profileSamplingEnd(arena, 10);
+#endif
 }